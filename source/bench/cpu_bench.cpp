@@ -0,0 +1,67 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <cstdio>
+#include <cstdlib>
+
+#include "libcpu/bench.h"
+#include "libcpu/cpu.h"
+#include "libcpu/dispatch.h"
+#include "libcpu/tsc.h"
+
+using namespace libcpu;
+
+static const char *BENCH_FENCE_STR[] = { "lfence/rdtscp", "serialize",
+                                         "lfence" };
+
+static int sum_c(const int *values, int count)
+{
+  int sum = 0;
+  for (int i = 0; i < count; ++i)
+    sum += values[i];
+  return sum;
+}
+
+static void print_result(const char *name, const BenchResult &r)
+{
+  if (r.samples.empty())
+  {
+    printf("%-24s : failed\n", name);
+    return;
+  }
+  printf("%-24s : %8.1f %8.1f %8.1f %8.1f %8.1f  %8.1f  %s\n", name, r.min,
+         r.median, r.p90, r.p99, r.max, r.median * r.nsPerCycle,
+         r.clockStable ? "" : "(clock changed)");
+}
+
+int main(int argc, char *argv[])
+{
+  BenchOptions options;
+  options.cpu = (argc > 1) ? atoi(argv[1]) : 0;
+
+  static int values[64];
+  static auto sum = Dispatcher<int (*)(const int *, int)>()
+                      .add(sum_c, {}, 0, "c")
+                      .resolve();
+
+  BenchResult overhead = bench([]() { return 0; }, options);
+  printf("cpu %d, fence %s, overhead %.0f cycles, %.3f ns/cycle\n",
+         overhead.cpu, BENCH_FENCE_STR[static_cast<int>(overhead.fence)],
+         overhead.overhead, overhead.nsPerCycle);
+  printf("%-24s : %8s %8s %8s %8s %8s  %8s\n", "cycles per call", "min",
+         "median", "p90", "p99", "max", "ns");
+
+  print_result("empty", overhead);
+  print_result("cpuid(0)", bench([]() { return cpuid(0).eax; }, options));
+  print_result("current()",
+               bench([]() { return current().vendor[0]; }, options));
+  print_result("has<avx2>()", bench([]() { return has<Feature::avx2>(); },
+                                    options));
+  print_result("tsc_clock::now()",
+               bench([]() { return tsc_clock::now(); }, options));
+  print_result("dispatched sum(64)",
+               bench([]() { return sum(values, 64); }, options));
+
+  return 0;
+}
@@ -2,10 +2,27 @@
 // This file is subject to the terms and conditions defined in
 // file 'LICENSE', which is part of this source code package.
 //
+#include <atomic>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 
+#include "libcpu/affinity.h"
+#include "libcpu/bench.h"
+#include "libcpu/blocking.h"
+#include "libcpu/corelatency.h"
 #include "libcpu/cpu.h"
+#include "libcpu/livecpu.h"
+#include "libcpu/memprobe.h"
+#include "libcpu/placement.h"
+#include "libcpu/pmu.h"
+#include "libcpu/snapcache.h"
+#include "libcpu/topology.h"
+#include "libcpu/tsc.h"
+#include "libcpu/tscsync.h"
 
 using namespace libcpu;
 
@@ -13,7 +30,386 @@ static const char *TLB_PAGE_SIZE_STR[] = { "4KB", "2MB", "4MB", "1GB",
                                            "4KB...256MB(IA-64)" };
 
 static const char *CACHE_AND_TLB_TYPE_STR[] = { "null", "Data", "Instruction",
-                                              "Unified" };
+                                              "Unified", "Load", "Store" };
+
+static const char *TSC_SOURCE_STR[] = { "unknown", "leaf 15H",
+                                        "leaf 15H/16H", "brand",
+                                        "hypervisor" };
+
+static const char *HYPERVISOR_STR[] = { "none", "other", "KVM",
+                                        "Hyper-V", "Xen", "VMware" };
+
+static const char *TOPOLOGY_LEVEL_STR[] = { "invalid", "SMT",  "Core",
+                                            "Module",  "Tile", "Die",
+                                            "DieGrp",  "CCX" };
+
+static const char *cache_and_tlb_type_str(int type)
+{
+  if ((type < 0) || (type > 5))
+    return "unknown";
+  return CACHE_AND_TLB_TYPE_STR[type];
+}
+
+static const char *topology_level_str(int type)
+{
+  if ((type < 0) || (type > 7))
+    return "unknown";
+  return TOPOLOGY_LEVEL_STR[type];
+}
+
+static int print_topology(const Cpu &cpu)
+{
+  Topology topo;
+  if (!detect_topology(cpu, &topo))
+    fprintf(stderr, "warning: cannot change thread affinity\n");
+
+  printf("packages %d, dies %d, complexes %d, cores %d, threads %d\n",
+         topo.packages, topo.dies, topo.complexes, topo.cores, topo.threads);
+  printf("%-6s %-8s %-7s %-4s %-4s %-4s %-6s %-4s %-6s %-4s\n", "cpu",
+         "x2apic", "package", "die", "ccx", "tile", "module", "core", "thread",
+         "node");
+  for (const LogicalCpu &c : topo.cpus)
+    printf("%-6d %08x %-7d %-4d %-4d %-4d %-6d %-4d %-6d %-4d\n", c.index,
+           c.x2apicId, c.package, c.die, c.complex, c.tile, c.module, c.core,
+           c.thread, c.node);
+
+  printf("\n%-6s %-12s %-8s %-8s %s\n", "level", "type", "id", "size(KB)",
+         "cpus");
+  for (const CacheInstance &i : topo.caches)
+  {
+    printf("L%-5d %-12s %08x %-8d", i.level, cache_and_tlb_type_str(i.type),
+           i.id, i.size);
+    for (size_t n = 0; n < i.cpus.size(); ++n)
+      printf("%s%d", (n == 0) ? " " : ",", i.cpus[n]);
+    printf("\n");
+  }
+  return 0;
+}
+
+static const char *core_type_str(int type)
+{
+  switch (type)
+  {
+  case CORE_TYPE_ATOM:
+    return "E-core";
+  case CORE_TYPE_CORE:
+    return "P-core";
+  case CORE_TYPE_NONE:
+    return "-";
+  default:
+    return "unknown";
+  }
+}
+
+static int print_all()
+{
+  std::vector<Cpu> cpus;
+  if (!detect_cpu_info_all(&cpus))
+    fprintf(stderr, "warning: some logical processors were not captured\n");
+
+  printf("%-6s %-8s %-7s %-8s %-8s %-8s %-8s %s\n", "cpu", "x2apic", "type",
+         "L1d(KB)", "L1i(KB)", "L2(KB)", "L3(KB)", "level");
+  for (const Cpu &cpu : cpus)
+  {
+    int size[4] = { 0, 0, 0, 0 };
+    for (const Cache &c : cpu.cache)
+    {
+      if ((c.level == 1) && (c.type == 1))
+        size[0] = c.size;
+      else if ((c.level == 1) && (c.type == 2))
+        size[1] = c.size;
+      else if ((c.level == 2) || (c.level == 3))
+        size[c.level] = c.size;
+    }
+    printf("%-6d %08x %-7s %-8d %-8d %-8d %-8d %s\n", cpu.cpuIndex,
+           cpu.x2apicId, core_type_str(cpu.coreType), size[0], size[1],
+           size[2], size[3], isa_level_name(isa_level(cpu)));
+  }
+  return 0;
+}
+
+static int print_placement(int threads)
+{
+  static const struct
+  {
+    PlacementPolicy policy;
+    const char *name;
+  } policies[] = { { PlacementPolicy::spreadLlc, "spreadLlc" },
+                   { PlacementPolicy::packLlc, "packLlc" },
+                   { PlacementPolicy::avoidSmt, "avoidSmt" },
+                   { PlacementPolicy::performanceFirst, "performanceFirst" } };
+
+  for (const auto &p : policies)
+  {
+    std::vector<int> plan = plan_placement(threads, p.policy);
+    printf("%-17s:", p.name);
+    for (int cpu : plan)
+      printf(" %d", cpu);
+    printf("\n");
+  }
+  return 0;
+}
+
+static int print_blocking(const Cpu &cpu)
+{
+  printf("%-6s %-10s %-10s %-6s %-5s %-7s\n", "level", "size", "usable",
+         "line", "ways", "sharing");
+  for (int level = 1; level <= last_level_cache(cpu); ++level)
+  {
+    CacheBudget b;
+    if (!cache_budget(cpu, level, &b))
+      continue;
+    printf("L%-5d %-10zu %-10zu %-6zu %-5d %-7d\n", b.level, b.size, b.usable,
+           b.lineSize, b.ways, b.sharing);
+  }
+  printf("\n");
+  for (int streams = 1; streams <= 4; ++streams)
+    printf("L1 tile bytes for %d stream(s)      : %zu\n", streams,
+           l1_tile_bytes(cpu, streams));
+  printf("L2 block elements of 4/8 bytes     : %zu/%zu\n",
+         l2_block_elements(cpu, 4), l2_block_elements(cpu, 8));
+  for (int threads = 1; threads <= 16; threads *= 4)
+    printf("LLC share bytes for %2d thread(s)   : %zu\n", threads,
+           llc_share_bytes(cpu, threads));
+  return 0;
+}
+
+static int print_memory_probe(const Cpu &cpu)
+{
+  MemoryProbeOptions options;
+  MemoryProbe single, all;
+  bool hasAll = online_cpus().size() > 1;
+
+  if (!probe_memory(cpu, options, &single))
+  {
+    fprintf(stderr, "error: memory probe failed\n");
+    return 1;
+  }
+  options.threads = 0;
+  if (hasAll && !probe_memory(cpu, options, &all))
+  {
+    fprintf(stderr, "warning: all-threads memory probe failed\n");
+    hasAll = false;
+  }
+
+  printf("%-12s %-12s %-14s", "size(KB)", "latency(ns)", "bandwidth(GB/s)");
+  if (hasAll)
+    printf(" %-12s %s(%d threads)", "latency(ns)", "bandwidth(GB/s)",
+           all.threads);
+  printf("\n");
+  for (size_t i = 0; i < single.points.size(); ++i)
+  {
+    const MemoryProbePoint &p = single.points[i];
+    printf("%-12zu %-12.2f %-14.2f", p.bytes / 1024, p.latency, p.bandwidth);
+    if (hasAll && (i < all.points.size()))
+      printf(" %-12.2f %.2f", all.points[i].latency, all.points[i].bandwidth);
+    printf("\n");
+  }
+
+  printf("\n%-6s %-14s %-16s", "level", "cpuid(KB)", "measured(KB)");
+  if (hasAll)
+    printf(" %s", "measured/thread(KB, all threads)");
+  printf("\n");
+  for (int level = 1; level <= last_level_cache(cpu); ++level)
+  {
+    CacheBudget b;
+    size_t n = static_cast<size_t>(level - 1);
+    if (!cache_budget(cpu, level, &b))
+      continue;
+    printf("L%-5d %-14zu ", level, b.size / 1024);
+    if (n < single.boundaries.size())
+      printf("%-16zu", single.boundaries[n] / 1024);
+    else
+      printf("%-16s", "-");
+    if (hasAll && (n < all.boundaries.size()))
+      printf(" %zu", all.boundaries[n] / 1024);
+    printf("\n");
+  }
+  return 0;
+}
+
+static int print_core_latency(const char *format)
+{
+  CoreLatencyOptions options;
+  CoreLatency latency;
+
+  if (!measure_core_latency(options, &latency))
+    fprintf(stderr, "warning: some processor pairs could not be pinned\n");
+
+  if (strcmp(format, "json") == 0)
+    printf("%s", core_latency_json(latency).c_str());
+  else
+    printf("%s", core_latency_csv(latency).c_str());
+  return 0;
+}
+
+static int print_tsc_sync(const Cpu &cpu)
+{
+  TscSync sync;
+
+  check_tsc_sync(TscSyncOptions(), &sync);
+
+  printf("invariant TSC       : %d\n", cpu.invariantTsc);
+  printf("%-6s %-14s %s\n", "cpu", "offset(cycles)", "uncertainty(cycles)");
+  for (size_t i = 0; i < sync.cpus.size(); ++i)
+    printf("%-6d %-14lld %lld\n", sync.cpus[i],
+           static_cast<long long>(sync.offsets[i]),
+           static_cast<long long>(sync.uncertainties[i]));
+  printf("max skew (cycles)   : %lld\n", static_cast<long long>(sync.maxSkew));
+  printf("max warp (cycles)   : %lld\n", static_cast<long long>(sync.maxWarp));
+  printf("violations          : %llu\n",
+         static_cast<unsigned long long>(sync.violations));
+  printf("all cpus pinned     : %d\n", sync.complete);
+  printf("synchronized        : %d\n", sync.synchronized);
+  printf("tsc_clock reliable  : %d\n", cpu.invariantTsc && sync.synchronized);
+  return (cpu.invariantTsc && sync.synchronized) ? 0 : 2;
+}
+
+static int print_cpuid_cost(const CpuidSnapshot &snapshot, int cpu)
+{
+  BenchOptions options;
+  options.cpu     = cpu;
+  options.warmup  = 10;
+  options.samples = 200;
+
+  std::vector<CpuidCost> costs = measure_cpuid_cost(snapshot, options);
+  double total = 0.0;
+
+  if (costs.empty() || (costs[0].result.cpu != cpu))
+  {
+    fprintf(stderr, "cannot run on cpu %d\n", cpu);
+    return 1;
+  }
+
+  printf("cpu %d, cycles per CPUID\n", cpu);
+  printf("%-8s %-8s %10s %10s %10s %10s\n", "leaf", "subleaf", "min",
+         "median", "p99", "ns");
+  for (const CpuidCost &c : costs)
+  {
+    printf("%08x %08x %10.0f %10.0f %10.0f %10.0f\n", c.leaf, c.subleaf,
+           c.result.min, c.result.median, c.result.p99,
+           c.result.median * c.result.nsPerCycle);
+    total += c.result.median;
+  }
+
+  options.warmup  = 1;
+  options.samples = 20;
+  BenchResult capture = bench(
+    []() {
+      CpuidSnapshot s;
+      capture_cpuid(&s);
+      return s.executed;
+    },
+    options);
+
+  printf("sum of medians (cycles)     : %.0f\n", total);
+  printf("capture_cpuid() (cycles)    : %.0f\n", capture.median);
+  printf("capture_cpuid() (us)        : %.1f\n",
+         capture.median * capture.nsPerCycle / 1000.0);
+  return 0;
+}
+
+static int write_cache(const CpuidSnapshot &snapshot, const char *path)
+{
+  if (!write_snapshot_cache(snapshot, path))
+  {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  const SnapshotFile *file = map_snapshot_cache(path);
+  if (file == nullptr)
+  {
+    fprintf(stderr, "%s is not usable (no boot ID?)\n", path);
+    return 2;
+  }
+  unmap_snapshot_cache(file);
+  printf("%s\n", path);
+  return 0;
+}
+
+static std::atomic<bool> serveStop(false);
+
+static void stop_serving(int)
+{
+  serveStop.store(true);
+}
+
+static int serve(int interval)
+{
+  signal(SIGINT, stop_serving);
+  signal(SIGTERM, stop_serving);
+
+  if (!serve_live_cpu_info(LIVE_CPU_SHM_NAME, interval, serveStop))
+  {
+    fprintf(stderr, "cannot publish %s\n", LIVE_CPU_SHM_NAME);
+    return 1;
+  }
+  return 0;
+}
+
+static int print_live()
+{
+  const LiveCpuShared *shared = map_live_cpu_info();
+  LiveCpuData *data = new LiveCpuData;
+
+  if ((shared == nullptr) || !read_live_cpu_info(*shared, data))
+  {
+    fprintf(stderr, "nothing published at %s (run --serve)\n",
+            LIVE_CPU_SHM_NAME);
+    delete data;
+    return 1;
+  }
+
+  printf("generation          : %llu\n",
+         static_cast<unsigned long long>(data->generation));
+  printf("brand               : %s\n", data->brand);
+  printf("TSC frequency (Hz)  : %llu\n",
+         static_cast<unsigned long long>(data->tscFrequency));
+  printf("packages/dies/cores/threads : %d/%d/%d/%d\n", data->packages,
+         data->dies, data->cores, data->threads);
+  printf("%-6s %-10s %-8s %-6s %-6s %-6s %s\n", "cpu", "x2apic", "package",
+         "die", "core", "smt", "kHz");
+  for (int i = 0; i < data->count; ++i)
+  {
+    const LiveLogicalCpu &c = data->cpus[i];
+    printf("%-6d %-10u %-8d %-6d %-6d %-6d %u\n", c.index, c.x2apicId,
+           c.package, c.die, c.core, c.thread, c.frequency);
+  }
+
+  delete data;
+  return 0;
+}
+
+static int print_pmu()
+{
+  PmuGroup pmu;
+
+  if (!pmu.open())
+  {
+    printf("no architectural performance counters available\n");
+    return 2;
+  }
+
+  // a pointer chase over 8MB to give the counters something to see
+  std::vector<uint32_t> next(2 * 1024 * 1024);
+  for (size_t i = 0; i < next.size(); ++i)
+    next[i] = static_cast<uint32_t>((i * 40503u + 1) % next.size());
+
+  pmu.start();
+  uint32_t p = 0;
+  for (size_t i = 0; i < next.size(); ++i)
+    p = next[p];
+  pmu.stop();
+
+  const PmuSample &sample = pmu.read();
+  printf("read path           : %s\n", pmu.uses_rdpmc() ? "rdpmc" : "read()");
+  for (PmuEvent e : pmu.get_events())
+    printf("%-20s: %llu\n", pmu_event_name(e),
+           static_cast<unsigned long long>(sample.get(e)));
+  printf("ipc                 : %.2f\n", sample.ipc());
+  printf("chase end           : %u\n", p);
+  return 0;
+}
 
 static void tlb_page_size_str(int sizeFlags, std::string &name)
 {
@@ -53,13 +449,82 @@ static void tlb_page_size_str(int sizeFlags, std::string &name)
   }
 }
 
-int main(void)
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [option]\n", name);
+  fprintf(stderr, "  (none)     print cpuid and decoded cpu information\n");
+  fprintf(stderr, "  --level    print x86-64 micro-architecture level\n");
+  fprintf(stderr, "  --topology print topology of every logical processor\n");
+  fprintf(stderr, "  --all      print core type, caches and level per processor\n");
+  fprintf(stderr, "  --blocking working set budgets per cache level\n");
+  fprintf(stderr, "  --probe-memory\n");
+  fprintf(stderr, "             measure latency and bandwidth per working set size\n");
+  fprintf(stderr, "  --core-latency [csv|json]\n");
+  fprintf(stderr, "             round trip latency between every processor pair\n");
+  fprintf(stderr, "  --tsc-sync TSC offsets and monotonicity across processors\n");
+  fprintf(stderr, "  --cpuid-cost [cpu]\n");
+  fprintf(stderr, "             cycles of every CPUID leaf on one processor\n");
+  fprintf(stderr, "  --write-cache [path]\n");
+  fprintf(stderr, "             write the snapshot cache (default %s)\n",
+          SNAPSHOT_CACHE_PATH);
+  fprintf(stderr, "  --serve [ms]\n");
+  fprintf(stderr, "             publish live topology to shared memory %s\n",
+          LIVE_CPU_SHM_NAME);
+  fprintf(stderr, "  --live     print the data published by --serve\n");
+  fprintf(stderr, "  --pmu      count the architectural PMU events of a test loop\n");
+  fprintf(stderr, "  --placement N\n");
+  fprintf(stderr, "             print the processor of N threads for each policy\n");
+}
+
+int main(int argc, char *argv[])
 {
   Cpu cpu;
-  detect_cpu_info(&cpu);
+  CpuidSnapshot snapshot;
+  capture_cpuid(&snapshot);
+  detect_cpu_info(&cpu, snapshot);
+
+  if (argc > 1)
+  {
+    if (strcmp(argv[1], "--level") == 0)
+    {
+      printf("%s\n", isa_level_name(isa_level(cpu)));
+      return 0;
+    }
+    if (strcmp(argv[1], "--topology") == 0)
+      return print_topology(cpu);
+    if (strcmp(argv[1], "--all") == 0)
+      return print_all();
+    if (strcmp(argv[1], "--blocking") == 0)
+      return print_blocking(cpu);
+    if (strcmp(argv[1], "--probe-memory") == 0)
+      return print_memory_probe(cpu);
+    if ((strcmp(argv[1], "--core-latency") == 0) &&
+        ((argc < 3) || (strcmp(argv[2], "csv") == 0) ||
+         (strcmp(argv[2], "json") == 0)))
+      return print_core_latency((argc > 2) ? argv[2] : "csv");
+    if (strcmp(argv[1], "--tsc-sync") == 0)
+      return print_tsc_sync(cpu);
+    if (strcmp(argv[1], "--cpuid-cost") == 0)
+      return print_cpuid_cost(snapshot, (argc > 2) ? atoi(argv[2])
+                                                   : online_cpus().front());
+    if (strcmp(argv[1], "--write-cache") == 0)
+      return write_cache(snapshot, (argc > 2) ? argv[2] : SNAPSHOT_CACHE_PATH);
+    if (strcmp(argv[1], "--serve") == 0)
+      return serve(((argc > 2) && (atoi(argv[2]) > 0)) ? atoi(argv[2]) : 1000);
+    if (strcmp(argv[1], "--live") == 0)
+      return print_live();
+    if (strcmp(argv[1], "--pmu") == 0)
+      return print_pmu();
+    if ((strcmp(argv[1], "--placement") == 0) && (argc > 2) &&
+        (atoi(argv[2]) > 0))
+      return print_placement(atoi(argv[2]));
+    usage(argv[0]);
+    return 1;
+  }
 
-  print_cpuid();
+  print_cpuid(snapshot);
   printf("\n");
+  printf("CPUID instructions executed                         : %d\n", snapshot.executed);
   printf("vendor                                              : %s\n", cpu.vendor);
   printf("brand                                               : %s\n", cpu.brand);
   printf("serialnumber                                        : ");
@@ -76,17 +541,38 @@ int main(void)
   printf("CLFLUSH line size(bytes)                            : %d\n", cpu.clflashChunkCount * 8);
   printf("number of logical processors per physical processor : %d\n", cpu.logicalProcessors);
   printf("local APIC ID                                       : %d\n", cpu.apicId);
+  printf("x2APIC ID                                           : %u\n", cpu.x2apicId);
+  for (size_t i = 0; i < cpu.topology.size(); ++i)
+  {
+    const TopologyLevel &l = cpu.topology[i];
+    printf("-- topology level %zd ---\n", i);
+    printf("level type                                          : %d(%s)\n", l.type, topology_level_str(l.type));
+    printf("x2APIC ID shift to next level                       : %d\n", l.shift);
+    printf("logical processors at this level                    : %d\n", l.count);
+  }
+  printf("x86-64 micro-architecture level                     : %s\n", isa_level_name(isa_level(cpu)));
+  printf("XCR0 (OS enabled XSAVE state)                       : %016llx\n", static_cast<unsigned long long>(cpu.xcr0));
+  printf("extended APIC ID                                    : %u\n", cpu.extendedApicId);
+  printf("compute unit ID                                     : %d\n", cpu.computeUnitId);
+  printf("threads per compute unit                            : %d\n", cpu.threadsPerComputeUnit);
+  printf("node ID                                             : %d\n", cpu.nodeId);
+  printf("nodes per processor                                 : %d\n", cpu.nodesPerProcessor);
+  printf("serialize                                           : %d\n", cpu.serialize);
+  printf("hybrid                                              : %d\n", cpu.hybrid);
+  printf("core type                                           : %02x(%s)\n", cpu.coreType, core_type_str(cpu.coreType));
   for (size_t i = 0; i < cpu.cache.size(); ++i)
   {
     const Cache &c = cpu.cache[i];
     printf("-- cache %zd ---\n", i);
-    printf("cache type                                          : %d(%s)\n", c.type, CACHE_AND_TLB_TYPE_STR[c.type]);
+    printf("cache type                                          : %d(%s)\n", c.type, cache_and_tlb_type_str(c.type));
     printf("cache level                                         : %d\n", c.level);
     printf("cache size(KB)                                      : %d\n", c.size);
     printf("self-initializing cache level                       : %d\n", c.selfInit);
     printf("fully associative cache                             : %d\n", c.fullAssociative);
     printf("extra threads sharing this cache                    : %d\n", c.thread);
     printf("extra processor cores on this die                   : %d\n", c.cores);
+    printf("x2APIC ID shift of the sharing processors           : %d\n", c.shareShift);
+    printf("cache instance ID                                   : %u\n", c.instanceId);
     printf("system coherency line size<(byte)                   : %d\n", c.coherencyLineSize);
     printf("physical line partitions                            : %d\n", c.partition);
     printf("ways of associativity                               : %d\n", c.ways);
@@ -101,11 +587,14 @@ int main(void)
     std::string name = "";
     tlb_page_size_str(t.pageSizeFlags, name);
     printf("-- TLB %zd ---\n", i);
-    printf("TLB type                                            : %d(%s)\n", t.type, CACHE_AND_TLB_TYPE_STR[t.type]);
+    printf("TLB type                                            : %d(%s)\n", t.type, cache_and_tlb_type_str(t.type));
     printf("TLB level                                           : %d\n", t.level);
     printf("TLB Size                                            : %d(%s)\n", t.pageSizeFlags, name.c_str());
     printf("TLB ways of assosiatvity                            : %d\n", t.ways);
     printf("TLB number of entories                              : %d\n", t.entories);
+    printf("TLB number of sets                                  : %d\n", t.sets);
+    printf("TLB fully associative                               : %d\n", t.fullAssociative);
+    printf("logical processors sharing this TLB                 : %d\n", t.thread);
   }
   printf("Prefetch Size (byte)                                : %d\n", cpu.prefetchSize);
   printf("SSE3                                                : %d\n", cpu.sse3);
@@ -136,6 +625,30 @@ int main(void)
   printf("F16C (half-precision) FP support                    : %d\n", cpu.f16c);
   printf("RDRAND                                              : %d\n", cpu.rdrnd);
   printf("Running on a hypervisor                             : %d\n", cpu.hypervisor);
+  printf("hypervisor                                          : %s(%s)\n", HYPERVISOR_STR[cpu.hypervisorType], cpu.hypervisorVendor);
+  printf("Maximum hypervisor leaf                             : %08x\n", cpu.maxHypervisorLeaf);
+  printf("hypervisor TSC frequency (in Hz)                    : %llu\n", static_cast<unsigned long long>(cpu.hypervisorTscFrequency));
+  printf("hypervisor APIC timer frequency (in Hz)             : %llu\n", static_cast<unsigned long long>(cpu.hypervisorApicFrequency));
+  printf("KVM kvmclock                                        : %d\n", cpu.kvmClocksource2);
+  printf("KVM kvmclock stable                                 : %d\n", cpu.kvmClocksourceStable);
+  printf("KVM asynchronous page faults                        : %d\n", cpu.kvmAsyncPf);
+  printf("KVM steal time                                      : %d\n", cpu.kvmStealTime);
+  printf("KVM paravirtual EOI                                 : %d\n", cpu.kvmPvEoi);
+  printf("KVM paravirtual spinlocks                           : %d\n", cpu.kvmPvUnhalt);
+  printf("KVM paravirtual TLB flush                           : %d\n", cpu.kvmPvTlbFlush);
+  printf("KVM paravirtual send IPI                            : %d\n", cpu.kvmPvSendIpi);
+  printf("KVM paravirtual sched yield                         : %d\n", cpu.kvmPvSchedYield);
+  printf("KVM realtime hint (dedicated vCPUs)                 : %d\n", cpu.kvmHintsRealtime);
+  printf("Hyper-V reference counter                           : %d\n", cpu.hypervReferenceCounter);
+  printf("Hyper-V reference TSC page                          : %d\n", cpu.hypervReferenceTsc);
+  printf("Hyper-V synthetic interrupt controller              : %d\n", cpu.hypervSynic);
+  printf("Hyper-V synthetic timers                            : %d\n", cpu.hypervSyntheticTimers);
+  printf("Hyper-V APIC access MSRs                            : %d\n", cpu.hypervApicMsrs);
+  printf("Hyper-V frequency MSRs                              : %d\n", cpu.hypervFrequencyMsrs);
+  printf("Hyper-V relaxed timing                              : %d\n", cpu.hypervRelaxedTiming);
+  printf("Hyper-V spinlock retries                            : %08x\n", cpu.hypervSpinlockRetries);
+  printf("Xen version                                         : %u.%u\n", cpu.xenVersion >> 16, cpu.xenVersion & 0xffff);
+  printf("dedicated cpus                                      : %d\n", dedicated_cpus(cpu));
   printf("Floating Point Unit On-Chip                         : %d\n", cpu.fpu);
   printf("Virtual 8086 Mode Enhancements                      : %d\n", cpu.mve);
   printf("Debugging Extensions                                : %d\n", cpu.de);
@@ -222,6 +735,11 @@ int main(void)
   printf("Processor Base Frequency (in MHz)                   : %d\n", cpu.baseFrequency);
   printf("Maximum Frequency (in MHz)                          : %d\n", cpu.maxFrequency);
   printf("Bus (Reference) Frequency (in MHz)                  : %d\n", cpu.busFrequency);
+  printf("invariant TSC                                       : %d\n", cpu.invariantTsc);
+  printf("TSC/crystal clock ratio                             : %u/%u\n", cpu.tscRatioNumerator, cpu.tscRatioDenominator);
+  printf("Core crystal clock frequency (in Hz)                : %llu\n", static_cast<unsigned long long>(cpu.crystalFrequency));
+  printf("TSC frequency (in Hz)                               : %llu(%s)\n", static_cast<unsigned long long>(cpu.tscFrequency), TSC_SOURCE_STR[cpu.tscFrequencySource % 5]);
+  printf("TSC frequency calibrated (in Hz)                    : %llu\n", static_cast<unsigned long long>(calibrate_tsc_frequency()));
 
   return 0;
 }
\ No newline at end of file
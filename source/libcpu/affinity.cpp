@@ -0,0 +1,154 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "affinity.h"
+
+using namespace std;
+using namespace libcpu;
+
+vector<int> libcpu::online_cpus()
+{
+  vector<int> cpus;
+
+#if defined(_WIN32)
+  DWORD_PTR processMask, systemMask;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+  {
+    for (int i = 0; i < static_cast<int>(sizeof(DWORD_PTR) * 8); ++i)
+      if (processMask & (static_cast<DWORD_PTR>(1) << i))
+        cpus.push_back(i);
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int i = 0; i < CPU_SETSIZE; ++i)
+      if (CPU_ISSET(i, &set))
+        cpus.push_back(i);
+  }
+#endif
+
+  return cpus;
+}
+
+
+bool libcpu::get_thread_affinity(vector<int> *cpus)
+{
+  cpus->clear();
+
+#if defined(_WIN32)
+  // Windows has no getter: set a temporary mask and restore the old one
+  DWORD_PTR processMask, systemMask, oldMask;
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    return false;
+  oldMask = SetThreadAffinityMask(GetCurrentThread(), processMask);
+  if (oldMask == 0)
+    return false;
+  SetThreadAffinityMask(GetCurrentThread(), oldMask);
+  for (int i = 0; i < static_cast<int>(sizeof(DWORD_PTR) * 8); ++i)
+    if (oldMask & (static_cast<DWORD_PTR>(1) << i))
+      cpus->push_back(i);
+  return true;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    return false;
+  for (int i = 0; i < CPU_SETSIZE; ++i)
+    if (CPU_ISSET(i, &set))
+      cpus->push_back(i);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+#if defined(_WIN32)
+//!
+//! @brief affinity mask of a processor list (0 if a processor is out of range)
+//!
+static DWORD_PTR affinity_mask(const vector<int> &cpus)
+{
+  DWORD_PTR mask = 0;
+  for (int cpu : cpus)
+  {
+    if ((cpu < 0) || (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)))
+      return 0;
+    mask |= static_cast<DWORD_PTR>(1) << cpu;
+  }
+  return mask;
+}
+#elif defined(__linux__)
+//!
+//! @brief cpu set of a processor list
+//!
+//! @return false if a processor is out of range
+//!
+static bool affinity_set(const vector<int> &cpus, cpu_set_t *set)
+{
+  CPU_ZERO(set);
+  for (int cpu : cpus)
+  {
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+      return false;
+    CPU_SET(cpu, set);
+  }
+  return true;
+}
+#endif
+
+
+bool libcpu::set_thread_affinity(const vector<int> &cpus)
+{
+  if (cpus.empty())
+    return false;
+
+#if defined(_WIN32)
+  DWORD_PTR mask = affinity_mask(cpus);
+  return (mask != 0) && (SetThreadAffinityMask(GetCurrentThread(), mask) != 0);
+#elif defined(__linux__)
+  cpu_set_t set;
+  if (!affinity_set(cpus, &set))
+    return false;
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+
+bool libcpu::set_thread_affinity(thread *t, const vector<int> &cpus)
+{
+  if (cpus.empty() || !t->joinable())
+    return false;
+
+#if defined(_WIN32)
+  DWORD_PTR mask = affinity_mask(cpus);
+  return (mask != 0) &&
+         (SetThreadAffinityMask(static_cast<HANDLE>(t->native_handle()),
+                                mask) != 0);
+#elif defined(__linux__)
+  cpu_set_t set;
+  if (!affinity_set(cpus, &set))
+    return false;
+  return pthread_setaffinity_np(t->native_handle(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+
+bool libcpu::pin_thread(int cpu)
+{
+  return set_thread_affinity(vector<int>(1, cpu));
+}
@@ -0,0 +1,65 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_AFFINITY_H
+#define LIB_CPU_AFFINITY_H
+
+#include <thread>
+#include <vector>
+
+namespace libcpu {
+
+//!
+//! @brief logical processors the process is allowed to run on
+//!
+//! @return OS logical processor numbers in ascending order (empty if the OS
+//!         affinity interface is not available)
+//!
+std::vector<int> online_cpus();
+
+
+//!
+//! @brief read the affinity of the calling thread
+//!
+//! @param[out]   cpus    OS logical processor numbers
+//!
+//! @return true on success
+//!
+bool get_thread_affinity(std::vector<int> *cpus);
+
+
+//!
+//! @brief set the affinity of the calling thread
+//!
+//! @param[in]    cpus    OS logical processor numbers
+//!
+//! @return true on success
+//!
+bool set_thread_affinity(const std::vector<int> &cpus);
+
+
+//!
+//! @brief set the affinity of another thread
+//!
+//! @param[in]    thread  running thread
+//! @param[in]    cpus    OS logical processor numbers
+//!
+//! @return true on success
+//!
+bool set_thread_affinity(std::thread *thread, const std::vector<int> &cpus);
+
+
+//!
+//! @brief pin the calling thread to a single logical processor
+//!
+//! @param[in]    cpu     OS logical processor number
+//!
+//! @return true on success
+//!
+bool pin_thread(int cpu);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_AFFINITY_H
@@ -0,0 +1,146 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+
+#include "affinity.h"
+#include "bench.h"
+#include "cpu.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief length of the dependent add chain used to probe the core clock
+//!
+static const int CLOCK_PROBE_ADDS = 1 << 16;
+
+
+//!
+//! @brief value at a percentile of sorted samples
+//!
+static double percentile(const vector<double> &sorted, double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[min(index, sorted.size() - 1)];
+}
+
+
+BenchFence libcpu::bench_fence()
+{
+  const Cpu &cpu = current();
+
+  if (cpu.serialize && cpu.rdtscp)
+    return BenchFence::serialize;
+  if (cpu.rdtscp)
+    return BenchFence::lfence;
+  return BenchFence::lfenceOnly;
+}
+
+
+uint64_t libcpu::bench_clock_probe()
+{
+  uint64_t best = ~static_cast<uint64_t>(0);
+
+  // one add per core cycle; the best of a few runs filters interrupts
+  for (int run = 0; run < 5; ++run)
+  {
+    uint64_t x  = 0;
+    uint64_t t0 = bench_start<BenchFence::lfenceOnly>();
+    for (int i = 0; i < CLOCK_PROBE_ADDS; ++i)
+    {
+      x += 1;
+      do_not_optimize(x);
+    }
+    uint64_t t1 = bench_start<BenchFence::lfenceOnly>();
+    best        = min(best, t1 - t0);
+  }
+
+  return best;
+}
+
+
+bool libcpu::bench_begin(const BenchOptions &options, vector<int> *saved,
+                         BenchResult *result)
+{
+  result->fence = bench_fence();
+  result->cpu   = options.cpu;
+
+  if (options.cpu < 0)
+    return true;
+  if (!get_thread_affinity(saved))
+    saved->clear();
+  if (!pin_thread(options.cpu))
+  {
+    if (!saved->empty())
+      set_thread_affinity(*saved);
+    result->cpu = -1;
+    return false;
+  }
+
+  // let the core leave its idle state before the first probe
+  bench_clock_probe();
+  return true;
+}
+
+
+void libcpu::bench_end(const BenchOptions &options, const vector<int> &saved,
+                       vector<uint64_t> *raw, vector<uint64_t> *empty,
+                       uint64_t clockBefore, BenchResult *result)
+{
+  uint64_t clockAfter = bench_clock_probe();
+  double iterations   = max(options.iterations, 1);
+
+  if ((options.cpu >= 0) && !saved.empty())
+    set_thread_affinity(saved);
+
+  double drift = (clockBefore > clockAfter)
+                   ? static_cast<double>(clockBefore - clockAfter)
+                   : static_cast<double>(clockAfter - clockBefore);
+  result->clockStable = drift <= options.maxClockDrift * clockBefore;
+
+  // the cheapest empty region is the cost of the fences and TSC reads
+  uint64_t overhead = *min_element(empty->begin(), empty->end());
+  result->overhead  = static_cast<double>(overhead);
+
+  result->samples.resize(raw->size());
+  for (size_t s = 0; s < raw->size(); ++s)
+  {
+    uint64_t cycles = ((*raw)[s] > overhead) ? (*raw)[s] - overhead : 0;
+    result->samples[s] = cycles / iterations;
+  }
+  sort(result->samples.begin(), result->samples.end());
+
+  result->min    = result->samples.front();
+  result->median = percentile(result->samples, 0.50);
+  result->p90    = percentile(result->samples, 0.90);
+  result->p99    = percentile(result->samples, 0.99);
+  result->max    = result->samples.back();
+
+  uint64_t hz = tsc_clock::frequency();
+  result->nsPerCycle = (hz != 0) ? 1e9 / hz : 0.0;
+}
+
+
+vector<CpuidCost> libcpu::measure_cpuid_cost(const CpuidSnapshot &snapshot,
+                                             const BenchOptions &options)
+{
+  vector<CpuidCost> costs(snapshot.count);
+
+  for (int i = 0; i < snapshot.count; ++i)
+  {
+    uint32_t leaf    = snapshot.leaves[i].leaf;
+    uint32_t subleaf = snapshot.leaves[i].subleaf;
+
+    costs[i].leaf    = leaf;
+    costs[i].subleaf = subleaf;
+    costs[i].result  = bench([=]() { return cpuid(leaf, subleaf).eax; },
+                            options);
+    costs[i].result.samples.clear();
+  }
+
+  return costs;
+}
@@ -0,0 +1,323 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_BENCH_H
+#define LIB_CPU_BENCH_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "cpu.h"
+#include "tsc.h"
+
+namespace libcpu {
+
+//!
+//! @brief How the timed region is fenced
+//!
+enum class BenchFence
+{
+  //! @brief LFENCE; RDTSC; LFENCE before, RDTSCP; LFENCE after
+  lfence,
+
+  //! @brief SERIALIZE; RDTSC; LFENCE before, RDTSCP; SERIALIZE after
+  serialize,
+
+  //! @brief LFENCE; RDTSC; LFENCE on both sides (no RDTSCP)
+  lfenceOnly
+};
+
+//!
+//! @brief Parameters of a benchmark run
+//!
+struct BenchOptions
+{
+  //! @brief OS logical processor to run on (-1: do not pin)
+  int cpu = -1;
+
+  //! @brief untimed calls before the measurement
+  int warmup = 1000;
+
+  //! @brief timed samples
+  int samples = 10000;
+
+  //! @brief calls per sample; results are divided by it
+  int iterations = 1;
+
+  //! @brief accepted relative change of the core clock between the start
+  //!        and the end of the run
+  double maxClockDrift = 0.02;
+};
+
+//!
+//! @brief Result of a benchmark run, in TSC cycles per call with the
+//!        harness overhead subtracted
+//!
+struct BenchResult
+{
+  double min = 0.0;
+  double median = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+
+  //! @brief overhead of an empty timed region that was subtracted
+  double overhead = 0.0;
+
+  //! @brief nanoseconds per TSC cycle
+  double nsPerCycle = 0.0;
+
+  //! @brief fencing that was used
+  BenchFence fence = BenchFence::lfence;
+
+  //! @brief processor the run was pinned to (-1: not pinned)
+  int cpu = -1;
+
+  //! @brief core clock stayed within maxClockDrift during the run
+  bool clockStable = false;
+
+  //! @brief samples in cycles per call, sorted
+  std::vector<double> samples;
+};
+
+
+//!
+//! @brief fence and read the TSC at the start of a timed region
+//!
+template <BenchFence F>
+inline uint64_t bench_start()
+{
+#if defined(_MSC_VER)
+  if (F == BenchFence::serialize)
+    _serialize();
+  else
+    _mm_lfence();
+  uint64_t t = __rdtsc();
+  _mm_lfence();
+  return t;
+#else
+  if (F == BenchFence::serialize)
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xe8" ::: "memory");
+  else
+    __asm__ __volatile__("lfence" ::: "memory");
+  uint64_t t = __rdtsc();
+  // keeps the timed region from starting before the timestamp is taken
+  __asm__ __volatile__("lfence" ::: "memory");
+  return t;
+#endif
+}
+
+
+//!
+//! @brief read the TSC and fence at the end of a timed region
+//!
+template <BenchFence F>
+inline uint64_t bench_stop()
+{
+  unsigned int aux;
+  uint64_t t;
+
+#if defined(_MSC_VER)
+  if (F == BenchFence::lfenceOnly)
+  {
+    _mm_lfence();
+    t = __rdtsc();
+  }
+  else
+    t = __rdtscp(&aux);
+  if (F == BenchFence::serialize)
+    _serialize();
+  else
+    _mm_lfence();
+#else
+  if (F == BenchFence::lfenceOnly)
+  {
+    __asm__ __volatile__("lfence" ::: "memory");
+    t = __rdtsc();
+  }
+  else
+    t = __rdtscp(&aux);
+  if (F == BenchFence::serialize)
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xe8" ::: "memory");
+  else
+    __asm__ __volatile__("lfence" ::: "memory");
+#endif
+  (void)aux;
+  return t;
+}
+
+
+//!
+//! @brief prevent the compiler from discarding a value
+//!
+template <typename T>
+inline void do_not_optimize(const T &value)
+{
+#if defined(_MSC_VER)
+  static volatile const void *sink;
+  sink = &value;
+#else
+  __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#endif
+}
+
+
+//!
+//! @brief call a benchmarked function, keeping its result alive
+//!
+template <typename Fn>
+inline void bench_call(Fn &fn, std::false_type)
+{
+  do_not_optimize(fn());
+}
+
+
+//!
+//! @brief call a benchmarked function returning void
+//!
+template <typename Fn>
+inline void bench_call(Fn &fn, std::true_type)
+{
+  fn();
+}
+
+
+//!
+//! @brief fencing supported by the running processor
+//!
+BenchFence bench_fence();
+
+
+//!
+//! @brief core clock estimate: TSC cycles of a fixed dependent add chain
+//!
+uint64_t bench_clock_probe();
+
+
+//!
+//! @brief pin to a processor and warm it up (undone by bench_end())
+//!
+//! @param[in]    options   run parameters
+//! @param[out]   saved     affinity to restore
+//! @param[out]   result    fence and cpu are filled in
+//!
+//! @return false if the pinning failed
+//!
+bool bench_begin(const BenchOptions &options, std::vector<int> *saved,
+                 BenchResult *result);
+
+
+//!
+//! @brief restore the affinity and turn raw samples into statistics
+//!
+void bench_end(const BenchOptions &options, const std::vector<int> &saved,
+               std::vector<uint64_t> *raw, std::vector<uint64_t> *empty,
+               uint64_t clockBefore, BenchResult *result);
+
+
+//!
+//! @brief time one fencing flavour
+//!
+template <BenchFence F, typename Fn>
+inline void bench_run(Fn &fn, const BenchOptions &options,
+                      std::vector<uint64_t> *raw, std::vector<uint64_t> *empty)
+{
+  for (int i = 0; i < options.warmup; ++i)
+    fn();
+
+  for (size_t s = 0; s < raw->size(); ++s)
+  {
+    uint64_t t0 = bench_start<F>();
+    uint64_t t1 = bench_stop<F>();
+    (*empty)[s] = t1 - t0;
+  }
+
+  for (size_t s = 0; s < raw->size(); ++s)
+  {
+    uint64_t t0 = bench_start<F>();
+    for (int i = 0; i < options.iterations; ++i)
+      fn();
+    uint64_t t1 = bench_stop<F>();
+    (*raw)[s] = t1 - t0;
+  }
+}
+
+
+//!
+//! @brief measure a callable in TSC cycles per call
+//!
+//! The run is pinned to options.cpu, warmed up, fenced with SERIALIZE when
+//! available (LFENCE/RDTSCP otherwise), and the minimum cost of an empty
+//! timed region is subtracted from every sample. The core clock is probed
+//! before and after so that frequency changes during the run are reported.
+//!
+//! @code
+//!   libcpu::BenchResult r = libcpu::bench([&]() { return f(x); });
+//! @endcode
+//!
+//! @param[in]    fn        callable; its return value (if any) is kept alive
+//! @param[in]    options   run parameters
+//!
+//! @return statistics (empty samples if pinning failed)
+//!
+template <typename Fn>
+BenchResult bench(Fn fn, const BenchOptions &options = BenchOptions())
+{
+  BenchResult result;
+  std::vector<int> saved;
+  std::vector<uint64_t> raw(options.samples > 0 ? options.samples : 1);
+  std::vector<uint64_t> empty(raw.size());
+  auto call = [&fn]() { bench_call(fn, std::is_void<decltype(fn())>()); };
+
+  if (!bench_begin(options, &saved, &result))
+    return result;
+
+  uint64_t clockBefore = bench_clock_probe();
+  switch (result.fence)
+  {
+  case BenchFence::serialize:
+    bench_run<BenchFence::serialize>(call, options, &raw, &empty);
+    break;
+  case BenchFence::lfence:
+    bench_run<BenchFence::lfence>(call, options, &raw, &empty);
+    break;
+  case BenchFence::lfenceOnly:
+    bench_run<BenchFence::lfenceOnly>(call, options, &raw, &empty);
+    break;
+  }
+  bench_end(options, saved, &raw, &empty, clockBefore, &result);
+
+  return result;
+}
+
+
+//!
+//! @brief Cost of executing one CPUID leaf
+//!
+struct CpuidCost
+{
+  uint32_t leaf = 0;
+  uint32_t subleaf = 0;
+
+  //! @brief cycles per CPUID instruction
+  BenchResult result;
+};
+
+
+//!
+//! @brief time every leaf and subleaf of a snapshot
+//!
+//! @param[in]    snapshot  leaves to time (as enumerated by capture_cpuid())
+//! @param[in]    options   run parameters (pinning, samples)
+//!
+//! @return one entry per leaf, in snapshot order
+//!
+std::vector<CpuidCost> measure_cpuid_cost(const CpuidSnapshot &snapshot,
+                                          const BenchOptions &options);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_BENCH_H
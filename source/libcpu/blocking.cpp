@@ -0,0 +1,120 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+
+#include "blocking.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief round down to a multiple of the line size
+//!
+static size_t round_to_line(size_t bytes, size_t lineSize)
+{
+  return (lineSize == 0) ? bytes : (bytes / lineSize) * lineSize;
+}
+
+
+bool libcpu::cache_budget(const Cpu &cpu, int level, CacheBudget *budget)
+{
+  const Cache *found = nullptr;
+
+  *budget = CacheBudget();
+
+  for (const Cache &c : cpu.cache)
+  {
+    // data (1) or unified (3)
+    if ((c.level == level) && ((c.type == 1) || (c.type == 3)))
+    {
+      found = &c;
+      break;
+    }
+  }
+  if ((found == nullptr) || (found->size <= 0))
+    return false;
+
+  budget->level    = level;
+  budget->size     = static_cast<size_t>(found->size) * 1024;
+  budget->lineSize = (found->coherencyLineSize > 0) ?
+                       static_cast<size_t>(found->coherencyLineSize) : 64;
+  budget->sharing  = found->sharedCpus.empty() ?
+                       max(found->thread, 1) :
+                       static_cast<int>(found->sharedCpus.size());
+
+  if (!found->fullAssociative && (found->ways > 1) && (found->sets > 0))
+  {
+    budget->ways    = found->ways;
+    budget->waySize = static_cast<size_t>(found->sets) * budget->lineSize;
+    budget->usable  = budget->waySize * (found->ways - 1);
+  }
+  else
+  {
+    budget->usable = budget->size / 2;
+  }
+  budget->usable = round_to_line(budget->usable, budget->lineSize);
+
+  return true;
+}
+
+
+int libcpu::last_level_cache(const Cpu &cpu)
+{
+  int level = 0;
+
+  for (const Cache &c : cpu.cache)
+  {
+    if (((c.type == 1) || (c.type == 3)) && (c.level > level))
+      level = c.level;
+  }
+
+  return level;
+}
+
+
+size_t libcpu::l1_tile_bytes(const Cpu &cpu, int streams)
+{
+  CacheBudget budget;
+
+  if ((streams <= 0) || !cache_budget(cpu, 1, &budget))
+    return 0;
+
+  // whole ways per stream when every stream gets at least one
+  if ((budget.ways > 1) && (budget.ways - 1 >= streams))
+    return budget.waySize * ((budget.ways - 1) / streams);
+
+  return round_to_line(budget.usable / streams, budget.lineSize);
+}
+
+
+size_t libcpu::l2_block_elements(const Cpu &cpu, size_t elementSize)
+{
+  CacheBudget budget;
+  size_t bytes;
+
+  if ((elementSize == 0) || !cache_budget(cpu, 2, &budget))
+    return 0;
+
+  // an L2 shared by a cluster of cores (E-cores) is split between them;
+  // SMT siblings of one core are assumed to work on the same block
+  bytes = budget.usable;
+  if (!cpu.topology.empty() && (cpu.topology[0].type == 1) &&
+      (cpu.topology[0].count > 0) && (budget.sharing > cpu.topology[0].count))
+    bytes /= budget.sharing / cpu.topology[0].count;
+
+  return round_to_line(bytes, budget.lineSize) / elementSize;
+}
+
+
+size_t libcpu::llc_share_bytes(const Cpu &cpu, int threads)
+{
+  CacheBudget budget;
+
+  if ((threads <= 0) || !cache_budget(cpu, last_level_cache(cpu), &budget))
+    return 0;
+
+  return round_to_line(budget.usable / min(threads, budget.sharing),
+                       budget.lineSize);
+}
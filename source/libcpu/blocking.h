@@ -0,0 +1,107 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_BLOCKING_H
+#define LIB_CPU_BLOCKING_H
+
+#include <cstddef>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief Working set budget of one data cache level
+//!
+struct CacheBudget
+{
+  //! @brief cache level (start at 1), 0 if the level was not found
+  int level = 0;
+
+  //! @brief size of one cache instance (bytes)
+  size_t size = 0;
+
+  //! @brief bytes a working set may use without evicting itself: one way is
+  //!        left for stack, code and other data, and half of the cache is
+  //!        kept free if the associativity is unknown
+  size_t usable = 0;
+
+  //! @brief cache line size (bytes)
+  size_t lineSize = 0;
+
+  //! @brief bytes of one way (sets * lineSize)
+  size_t waySize = 0;
+
+  //! @brief ways of associativity (0 if unknown or fully associative)
+  int ways = 0;
+
+  //! @brief logical processors sharing one instance
+  int sharing = 1;
+};
+
+
+//!
+//! @brief budget of the data or unified cache of a level
+//!
+//! Works on leaf 04H and on AMD 8000001DH/80000005H/80000006H entries.
+//!
+//! @param[in]    cpu       decoded cpu information
+//! @param[in]    level     cache level (start at 1)
+//! @param[out]   budget    budget (level is 0 if there is no such cache)
+//!
+//! @return true if the level exists
+//!
+bool cache_budget(const Cpu &cpu, int level, CacheBudget *budget);
+
+
+//!
+//! @brief highest data or unified cache level
+//!
+//! @return level, 0 if no cache was decoded
+//!
+int last_level_cache(const Cpu &cpu);
+
+
+//!
+//! @brief L1 tile size per stream when a kernel walks several streams
+//!
+//! Each stream is given whole ways so that k streams laid out at arbitrary
+//! addresses cannot evict each other. If there are more streams than ways
+//! the usable size is split evenly instead.
+//!
+//! @param[in]    cpu       decoded cpu information
+//! @param[in]    streams   number of concurrently accessed arrays
+//!
+//! @return bytes per stream, a multiple of the line size (0 if unknown)
+//!
+size_t l1_tile_bytes(const Cpu &cpu, int streams);
+
+
+//!
+//! @brief L2 block size for one thread
+//!
+//! @param[in]    cpu         decoded cpu information
+//! @param[in]    elementSize bytes per element
+//!
+//! @return elements per block; the block occupies whole cache lines (0 if
+//!         unknown). For b x b square tiles use b = sqrt(result)
+//!
+size_t l2_block_elements(const Cpu &cpu, size_t elementSize);
+
+
+//!
+//! @brief last-level cache share of one thread
+//!
+//! @param[in]    cpu       decoded cpu information
+//! @param[in]    threads   threads active at the same time in the process;
+//!                         at most Cache::thread of them share one instance
+//!
+//! @return bytes per thread, a multiple of the line size (0 if unknown)
+//!
+size_t llc_share_bytes(const Cpu &cpu, int threads);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_BLOCKING_H
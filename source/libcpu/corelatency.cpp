@@ -0,0 +1,259 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <thread>
+
+#include "affinity.h"
+#include "corelatency.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief flag on its own cache line
+//!
+struct alignas(64) HandoffFlag
+{
+  atomic<int> value;
+  char padding[64 - sizeof(atomic<int>)];
+};
+
+
+//!
+//! @brief spin until the flag reaches a value
+//!
+static void wait_for(const HandoffFlag &flag, int value)
+{
+  for (int spins = 0; flag.value.load(memory_order_acquire) != value; ++spins)
+  {
+    // only matters when both threads ended up on one processor
+    if ((spins & 0xffff) == 0xffff)
+      this_thread::yield();
+  }
+}
+
+
+//!
+//! @brief fastest round trip of a pair (ns), negative if it cannot be pinned
+//!
+static double measure_pair(int first, int second, int roundTrips, int samples)
+{
+  HandoffFlag flag;
+  atomic<bool> pinned(true);
+  double best = -1.0;
+
+  flag.value.store(0);
+
+  thread pong([&]() {
+    if (!pin_thread(second))
+      pinned.store(false);
+    // handshake: -1 tells the ping thread that the pong thread is placed
+    flag.value.store(-1, memory_order_release);
+    for (int s = 0; s < samples; ++s)
+    {
+      for (int k = 1; k <= roundTrips; ++k)
+      {
+        wait_for(flag, 2 * k - 1);
+        flag.value.store(2 * k, memory_order_release);
+      }
+      wait_for(flag, 0);
+      flag.value.store(-1, memory_order_release);
+    }
+  });
+
+  thread ping([&]() {
+    if (!pin_thread(first))
+      pinned.store(false);
+    for (int s = 0; s < samples; ++s)
+    {
+      wait_for(flag, -1);
+      auto start = chrono::steady_clock::now();
+      for (int k = 1; k <= roundTrips; ++k)
+      {
+        flag.value.store(2 * k - 1, memory_order_release);
+        wait_for(flag, 2 * k);
+      }
+      double ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                                 start).count() / roundTrips;
+      if ((best < 0.0) || (ns < best))
+        best = ns;
+      flag.value.store(0, memory_order_release);
+    }
+  });
+
+  ping.join();
+  pong.join();
+
+  return pinned.load() ? best : -1.0;
+}
+
+
+bool libcpu::measure_core_latency(const CoreLatencyOptions &options,
+                                  CoreLatency *latency)
+{
+  bool result = true;
+  size_t n;
+
+  latency->cpus = options.cpus.empty() ? online_cpus() : options.cpus;
+  n = latency->cpus.size();
+  latency->roundTrip.assign(n * n, 0.0);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t j = i + 1; j < n; ++j)
+    {
+      double ns = measure_pair(latency->cpus[i], latency->cpus[j],
+                               max(options.roundTrips, 1),
+                               max(options.samples, 1));
+      latency->roundTrip[i * n + j] = ns;
+      latency->roundTrip[j * n + i] = ns;
+      result = result && (ns >= 0.0);
+    }
+  }
+
+  cluster_latency_domains(latency, options.tolerance);
+
+  return result;
+}
+
+
+void libcpu::cluster_latency_domains(CoreLatency *latency, double tolerance)
+{
+  size_t n = latency->cpus.size();
+  vector<double> values;
+  vector<double> limits;
+
+  latency->levels.clear();
+
+  for (size_t i = 0; i < n; ++i)
+    for (size_t j = i + 1; j < n; ++j)
+      if (latency->at(i, j) >= 0.0)
+        values.push_back(latency->at(i, j));
+  sort(values.begin(), values.end());
+
+  // upper bound of each latency class
+  for (size_t k = 0; k < values.size(); ++k)
+  {
+    if ((k + 1 == values.size()) || (values[k + 1] > values[k] * tolerance))
+      limits.push_back(values[k]);
+  }
+
+  for (double limit : limits)
+  {
+    LatencyDomainLevel level;
+    vector<size_t> parent(n);
+
+    iota(parent.begin(), parent.end(), 0);
+    auto root = [&](size_t x) {
+      while (parent[x] != x)
+        x = parent[x] = parent[parent[x]];
+      return x;
+    };
+
+    for (size_t i = 0; i < n; ++i)
+      for (size_t j = i + 1; j < n; ++j)
+        if ((latency->at(i, j) >= 0.0) && (latency->at(i, j) <= limit))
+          parent[root(j)] = root(i);
+
+    level.maxLatency = limit;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (root(i) != i)
+        continue;
+      level.domains.push_back(vector<int>());
+      for (size_t j = 0; j < n; ++j)
+        if (root(j) == i)
+          level.domains.back().push_back(latency->cpus[j]);
+    }
+    latency->levels.push_back(level);
+  }
+}
+
+
+string libcpu::core_latency_csv(const CoreLatency &latency)
+{
+  size_t n = latency.cpus.size();
+  string out = "cpu";
+  char buffer[32];
+
+  for (int cpu : latency.cpus)
+  {
+    snprintf(buffer, sizeof(buffer), ",%d", cpu);
+    out += buffer;
+  }
+  out += "\n";
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    snprintf(buffer, sizeof(buffer), "%d", latency.cpus[i]);
+    out += buffer;
+    for (size_t j = 0; j < n; ++j)
+    {
+      snprintf(buffer, sizeof(buffer), ",%.1f", latency.at(i, j));
+      out += buffer;
+    }
+    out += "\n";
+  }
+
+  return out;
+}
+
+
+string libcpu::core_latency_json(const CoreLatency &latency)
+{
+  size_t n = latency.cpus.size();
+  string out = "{\n  \"cpus\": [";
+  char buffer[32];
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    snprintf(buffer, sizeof(buffer), "%s%d", (i == 0) ? "" : ", ",
+             latency.cpus[i]);
+    out += buffer;
+  }
+  out += "],\n  \"roundTripNs\": [";
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    out += (i == 0) ? "\n    [" : ",\n    [";
+    for (size_t j = 0; j < n; ++j)
+    {
+      snprintf(buffer, sizeof(buffer), "%s%.1f", (j == 0) ? "" : ", ",
+               latency.at(i, j));
+      out += buffer;
+    }
+    out += "]";
+  }
+  out += "\n  ],\n  \"domains\": [";
+
+  for (size_t l = 0; l < latency.levels.size(); ++l)
+  {
+    const LatencyDomainLevel &level = latency.levels[l];
+    snprintf(buffer, sizeof(buffer), "%.1f", level.maxLatency);
+    out += (l == 0) ? "\n    " : ",\n    ";
+    out += "{ \"maxLatencyNs\": ";
+    out += buffer;
+    out += ", \"groups\": [";
+    for (size_t d = 0; d < level.domains.size(); ++d)
+    {
+      out += (d == 0) ? "[" : ", [";
+      for (size_t c = 0; c < level.domains[d].size(); ++c)
+      {
+        snprintf(buffer, sizeof(buffer), "%s%d", (c == 0) ? "" : ", ",
+                 level.domains[d][c]);
+        out += buffer;
+      }
+      out += "]";
+    }
+    out += "] }";
+  }
+  out += "\n  ]\n}\n";
+
+  return out;
+}
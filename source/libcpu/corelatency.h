@@ -0,0 +1,111 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_CORELATENCY_H
+#define LIB_CPU_CORELATENCY_H
+
+#include <string>
+#include <vector>
+
+namespace libcpu {
+
+//!
+//! @brief Parameters of the core-to-core latency benchmark
+//!
+struct CoreLatencyOptions
+{
+  //! @brief OS logical processors to measure (empty: every processor)
+  std::vector<int> cpus;
+
+  //! @brief flag round trips per sample
+  int roundTrips = 1000;
+
+  //! @brief samples per pair; the fastest one is kept
+  int samples = 5;
+
+  //! @brief latency ratio between neighbouring values that separates two
+  //!        latency classes
+  double tolerance = 1.3;
+};
+
+//!
+//! @brief Processors grouped at one latency class
+//!
+struct LatencyDomainLevel
+{
+  //! @brief largest round trip within a domain of this level (ns)
+  double maxLatency = 0.0;
+
+  //! @brief domains of this level, each a list of OS processor numbers
+  std::vector<std::vector<int>> domains;
+};
+
+//!
+//! @brief Round trip latency of a cache line handoff between processors
+//!
+struct CoreLatency
+{
+  //! @brief OS logical processors in row and column order
+  std::vector<int> cpus;
+
+  //! @brief row-major cpus.size() x cpus.size() round trips (ns); 0 on the
+  //!        diagonal, negative if the pair could not be measured
+  std::vector<double> roundTrip;
+
+  //! @brief latency domains from the tightest (e.g. SMT siblings) to the
+  //!        widest (e.g. the whole machine)
+  std::vector<LatencyDomainLevel> levels;
+
+  //! @brief round trip between the i-th and j-th processor (ns)
+  double at(size_t i, size_t j) const
+  {
+    return roundTrip[i * cpus.size() + j];
+  }
+};
+
+
+//!
+//! @brief measure the round trip latency between every pair of processors
+//!
+//! Two threads pinned to a pair hand an atomic flag back and forth on its
+//! own cache line. The pairs are measured one after another so that they
+//! do not disturb each other.
+//!
+//! @param[in]    options   benchmark parameters
+//! @param[out]   latency   matrix and latency domains
+//!
+//! @return false if some pair could not be pinned
+//!
+bool measure_core_latency(const CoreLatencyOptions &options,
+                          CoreLatency *latency);
+
+
+//!
+//! @brief group processors into latency domains
+//!
+//! The measured round trips are split into classes wherever neighbouring
+//! values differ by more than the tolerance. The domains of a class are the
+//! connected components of the pairs at or below its largest value.
+//!
+//! @param[in,out]  latency   matrix whose levels are recomputed
+//! @param[in]      tolerance class separation ratio
+//!
+void cluster_latency_domains(CoreLatency *latency, double tolerance = 1.3);
+
+
+//!
+//! @brief matrix as CSV (header row and column of OS processor numbers)
+//!
+std::string core_latency_csv(const CoreLatency &latency);
+
+
+//!
+//! @brief matrix and domains as JSON
+//!
+std::string core_latency_json(const CoreLatency &latency);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_CORELATENCY_H
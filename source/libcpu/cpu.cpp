@@ -3,6 +3,7 @@
 // file 'LICENSE', which is part of this source code package.
 //
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cstdint>
 
@@ -12,79 +13,116 @@
 #include <cpuid.h>
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "affinity.h"
 #include "cpu.h"
 
 using namespace std;
 using namespace libcpu;
 
-static void get_cpuid(int[4], int);
 static void get_cpuidex(int[4], int, int);
-static int detect_stdlevel_00000000(Cpu *);
-static void detect_stdlevel_00000001(Cpu *);
-static void detect_stdlevel_00000002(Cpu *);
-static void detect_stdlevel_00000003(Cpu *);
-static void detect_stdlevel_00000004(Cpu *);
-static void detect_stdlevel_00000005(Cpu *);
-static void detect_stdlevel_00000006(Cpu *);
-static void detect_stdlevel_00000007(Cpu *);
-//static void detect_stdlevel_00000008(Cpu *);
-static void detect_stdlevel_00000009(Cpu *);
-static void detect_stdlevel_0000000A(Cpu *);
-static void detect_stdlevel_0000000B(Cpu *);
-static void detect_stdlevel_00000016(Cpu *);
-static int detect_extlevel_80000000(Cpu *);
-static void detect_extlevel_80000001(Cpu *);
-static void detect_extlevel_80000002(Cpu *);
-static void detect_extlevel_80000003(Cpu *);
-static void detect_extlevel_80000004(Cpu *);
-static void detect_extlevel_80000005(Cpu *);
-static void detect_extlevel_80000006(Cpu *);
-static void detect_extlevel_80000008(Cpu *);
-static void detect_extlevel_8000000A(Cpu *);
-static void detect_extlevel_8000001A(Cpu *);
+static uint64_t get_xcr0();
+static void read_cpuid(const CpuidSnapshot &, int[4], uint32_t,
+                       uint32_t = 0);
+static int detect_stdlevel_00000000(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000001(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000002(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000003(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000004(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000005(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000006(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000007(Cpu *, const CpuidSnapshot &);
+//static void detect_stdlevel_00000008(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000009(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_0000000A(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_0000000B(Cpu *, const CpuidSnapshot &);
+static void detect_legacy_topology(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_0000000D(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000015(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000016(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_00000018(Cpu *, const CpuidSnapshot &);
+static void detect_stdlevel_0000001A(Cpu *, const CpuidSnapshot &);
+static uint32_t detect_hvlevel_40000000(Cpu *, const CpuidSnapshot &);
+static void detect_hvlevel_kvm(Cpu *, const CpuidSnapshot &);
+static void detect_hvlevel_hyperv(Cpu *, const CpuidSnapshot &);
+static void detect_hvlevel_xen(Cpu *, const CpuidSnapshot &);
+static void detect_hvlevel_40000010(Cpu *, const CpuidSnapshot &);
+static int detect_extlevel_80000000(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000001(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000002(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000003(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000004(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000005(Cpu *, const CpuidSnapshot &,
+                                     vector<Cache> *);
+static void detect_extlevel_80000006(Cpu *, const CpuidSnapshot &,
+                                     vector<Cache> *);
+static void detect_extlevel_80000007(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000008(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_8000000A(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_8000001A(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_8000001D(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_8000001E(Cpu *, const CpuidSnapshot &);
+static void detect_extlevel_80000026(Cpu *, const CpuidSnapshot &);
 static void detect_stdlevel_00000002_partial(Cpu *, uint8_t);
+static void detect_feature_set(Cpu *);
+static void detect_cache_instances(Cpu *);
+static void detect_tsc_frequency(Cpu *);
 
 void libcpu::detect_cpu_info(Cpu *cpu)
+{
+  CpuidSnapshot snapshot;
+
+  capture_cpuid(&snapshot);
+  detect_cpu_info(cpu, snapshot);
+}
+
+
+void libcpu::detect_cpu_info(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int stdLevel, extLevel;
 
-  stdLevel = detect_stdlevel_00000000(cpu);
+  stdLevel = detect_stdlevel_00000000(cpu, snapshot);
 
   if (stdLevel >= 0x000000001)
-    detect_stdlevel_00000001(cpu);
+    detect_stdlevel_00000001(cpu, snapshot);
 
   if (stdLevel >= 0x000000002)
-    detect_stdlevel_00000002(cpu);
+    detect_stdlevel_00000002(cpu, snapshot);
 
   if (stdLevel >= 0x000000003)
-    detect_stdlevel_00000003(cpu);
+    detect_stdlevel_00000003(cpu, snapshot);
 
   if (stdLevel >= 0x000000004)
-    detect_stdlevel_00000004(cpu);
+    detect_stdlevel_00000004(cpu, snapshot);
 
   if (stdLevel >= 0x000000005)
-    detect_stdlevel_00000005(cpu);
+    detect_stdlevel_00000005(cpu, snapshot);
 
   if (stdLevel >= 0x000000006)
-    detect_stdlevel_00000006(cpu);
+    detect_stdlevel_00000006(cpu, snapshot);
 
   if (stdLevel >= 0x000000007)
-    detect_stdlevel_00000007(cpu);
+    detect_stdlevel_00000007(cpu, snapshot);
 
   // EAX=0x8: Reserved
 
   if (stdLevel >= 0x000000009)
-    detect_stdlevel_00000009(cpu);
+    detect_stdlevel_00000009(cpu, snapshot);
 
   if (stdLevel >= 0x00000000A)
-    detect_stdlevel_0000000A(cpu);
+    detect_stdlevel_0000000A(cpu, snapshot);
 
   if (stdLevel >= 0x00000000B)
-    detect_stdlevel_0000000B(cpu);
+    detect_stdlevel_0000000B(cpu, snapshot);
 
   // EAX=0x0C: Processor Extended State Enumeration Main
 
-  // EAX=0x0D: Extended State Enumeration Sub
+  if (stdLevel >= 0x00000000D)
+    detect_stdlevel_0000000D(cpu, snapshot);
 
   // EAX=0x0E: Reserved
 
@@ -102,83 +140,382 @@ void libcpu::detect_cpu_info(Cpu *cpu)
 
   // EAX=0x15: Time Stamp Counter and Core Crystal Clock Information
 
+  if (stdLevel >= 0x15)
+    detect_stdlevel_00000015(cpu, snapshot);
+
   if (stdLevel >= 0x16)
-    detect_stdlevel_00000016(cpu);
+    detect_stdlevel_00000016(cpu, snapshot);
 
   // EAX=0x17: System-On-Chip Vendor Attribute Enumeration Main
 
   // EAX=0x18: Deterministic Address Translation Parameters Main
 
-  extLevel = detect_extlevel_80000000(cpu);
+  if (stdLevel >= 0x18)
+    detect_stdlevel_00000018(cpu, snapshot);
+
+  if ((stdLevel >= 0x1A) && cpu->hybrid)
+    detect_stdlevel_0000001A(cpu, snapshot);
+
+  if (cpu->hypervisor)
+  {
+    uint32_t hvLevel = detect_hvlevel_40000000(cpu, snapshot);
+
+    if (cpu->hypervisorType == HYPERVISOR_KVM)
+      detect_hvlevel_kvm(cpu, snapshot);
+
+    if ((cpu->hypervisorType == HYPERVISOR_HYPERV) && (hvLevel >= 0x40000004))
+      detect_hvlevel_hyperv(cpu, snapshot);
+
+    if ((cpu->hypervisorType == HYPERVISOR_XEN) && (hvLevel >= 0x40000003))
+      detect_hvlevel_xen(cpu, snapshot);
+
+    // EAX=0x40000010: timing information (VMware, also exposed by KVM)
+    if ((hvLevel >= 0x40000010) && (cpu->hypervisorType != HYPERVISOR_HYPERV))
+      detect_hvlevel_40000010(cpu, snapshot);
+  }
+
+  extLevel = detect_extlevel_80000000(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x80000001))
-    detect_extlevel_80000001(cpu);
+    detect_extlevel_80000001(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x80000002))
-    detect_extlevel_80000002(cpu);
+    detect_extlevel_80000002(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x80000003))
-    detect_extlevel_80000003(cpu);
+    detect_extlevel_80000003(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x80000004))
-    detect_extlevel_80000004(cpu);
+    detect_extlevel_80000004(cpu, snapshot);
+
+  // legacy L1/L2/L3 descriptors: TLBs always, caches only as a fallback
+  vector<Cache> legacyCaches;
 
   if (extLevel >= static_cast<int>(0x80000005))
-    detect_extlevel_80000005(cpu);
+    detect_extlevel_80000005(cpu, snapshot, &legacyCaches);
 
   if (extLevel >= static_cast<int>(0x80000006))
-    detect_extlevel_80000006(cpu);
+    detect_extlevel_80000006(cpu, snapshot, &legacyCaches);
+
+  if (extLevel >= static_cast<int>(0x80000007))
+    detect_extlevel_80000007(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x80000008))
-    detect_extlevel_80000008(cpu);
+    detect_extlevel_80000008(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x8000000a))
-    detect_extlevel_8000000A(cpu);
+    detect_extlevel_8000000A(cpu, snapshot);
 
   if (extLevel >= static_cast<int>(0x8000001a))
-    detect_extlevel_8000001A(cpu);
+    detect_extlevel_8000001A(cpu, snapshot);
+
+  if ((extLevel >= static_cast<int>(0x8000001d)) && cpu->topoExt &&
+      cpu->cache.empty())
+    detect_extlevel_8000001D(cpu, snapshot);
+
+  if (cpu->cache.empty())
+    cpu->cache = legacyCaches;
+
+  if ((extLevel >= static_cast<int>(0x8000001e)) && cpu->topoExt)
+    detect_extlevel_8000001E(cpu, snapshot);
+
+  if (extLevel >= static_cast<int>(0x80000026))
+    detect_extlevel_80000026(cpu, snapshot);
+
+  if (cpu->topology.empty())
+    detect_legacy_topology(cpu, snapshot);
+
+  detect_cache_instances(cpu);
+  detect_tsc_frequency(cpu);
+  detect_feature_set(cpu);
 }
 
 
 void libcpu::print_cpuid()
 {
-  Cpu tmpCpu;
-  int stdLevel, extLevel;
-  int cpuInfo[4];
+  CpuidSnapshot snapshot;
+
+  capture_cpuid(&snapshot);
+  print_cpuid(snapshot);
+}
 
-  stdLevel = detect_stdlevel_00000000(&tmpCpu);
 
+void libcpu::print_cpuid(const CpuidSnapshot &snapshot)
+{
   printf("%-8s %-8s %-8s %-8s %-8s\n", "Level", "EAX", "EBX", "ECX", "EDX");
-  for (int i = 0; i <= stdLevel; ++i)
+  for (int i = 0; i < snapshot.count; ++i)
   {
-    get_cpuid(cpuInfo, i);
-    printf("%08x %08x %08x %08x %08x\n", i, cpuInfo[0], cpuInfo[1], cpuInfo[2],
-           cpuInfo[3]);
+    const CpuidLeaf &l = snapshot.leaves[i];
+    if (l.subleaf != 0)
+      continue;
+    printf("%08x %08x %08x %08x %08x\n", l.leaf, l.eax, l.ebx, l.ecx, l.edx);
   }
+}
+
+
+const char *libcpu::feature_name(Feature f)
+{
+  static const char *const names[] = {
+#define LIBCPU_FEATURE_NAME(name) #name,
+    LIBCPU_FEATURE_LIST(LIBCPU_FEATURE_NAME)
+#undef LIBCPU_FEATURE_NAME
+  };
+  int idx = static_cast<int>(f);
+
+  if ((idx < 0) || (idx >= static_cast<int>(Feature::count)))
+    return "unknown";
+  return names[idx];
+}
+
+
+CpuidLeaf libcpu::cpuid(uint32_t leaf, uint32_t subleaf)
+{
+  CpuidLeaf l;
+  int cpuInfo[4];
+
+  get_cpuidex(cpuInfo, static_cast<int>(leaf), static_cast<int>(subleaf));
+  l.leaf    = leaf;
+  l.subleaf = subleaf;
+  l.eax     = static_cast<uint32_t>(cpuInfo[0]);
+  l.ebx     = static_cast<uint32_t>(cpuInfo[1]);
+  l.ecx     = static_cast<uint32_t>(cpuInfo[2]);
+  l.edx     = static_cast<uint32_t>(cpuInfo[3]);
+
+  return l;
+}
+
+
+const CpuidLeaf *CpuidSnapshot::find(uint32_t leaf, uint32_t subleaf) const
+{
+  int lo = 0, hi = count;
 
-  extLevel = detect_extlevel_80000000(&tmpCpu);
-  for (int i = 0x80000000; i <= extLevel; ++i)
+  while (lo < hi)
   {
-    get_cpuid(cpuInfo, i);
-    printf("%08x %08x %08x %08x %08x\n", i, cpuInfo[0], cpuInfo[1], cpuInfo[2],
-           cpuInfo[3]);
+    int mid = (lo + hi) / 2;
+    const CpuidLeaf &l = leaves[mid];
+    if ((l.leaf < leaf) || ((l.leaf == leaf) && (l.subleaf < subleaf)))
+      lo = mid + 1;
+    else
+      hi = mid;
   }
+
+  if ((lo < count) && (leaves[lo].leaf == leaf) &&
+      (leaves[lo].subleaf == subleaf))
+    return &leaves[lo];
+  return nullptr;
 }
 
 
 //!
-//! @brief read cpu id
+//! @brief where capture_leaf() reads CPUID from
 //!
-//! @param[out]   info    EAX, EBX, ECX, and EDX
-//! @param[in]    id      function id
+struct CpuidSource
+{
+  //! @brief destination
+  CpuidSnapshot *snapshot = nullptr;
+
+  //! @brief /dev/cpu/N/cpuid descriptor, -1 to execute CPUID directly
+  int fd = -1;
+
+  //! @brief false once a read failed
+  bool ok = true;
+};
+
+
+//!
+//! @brief execute CPUID and append the result to the snapshot
+//!
+//! @param[in,out]  source    source and destination
+//! @param[in]      leaf      function id
+//! @param[in]      subleaf   sub function id
 //!
-static void get_cpuid(int info[4], int id)
+//! @return captured entry (all zero if the snapshot is full)
+//!
+static CpuidLeaf capture_leaf(CpuidSource *source, uint32_t leaf,
+                              uint32_t subleaf)
 {
-#if defined(_MSC_VER)
-  __cpuid(info, id);
-#elif defined(__GNUC__)
-  __cpuid(id, info[0], info[1], info[2], info[3]);
+  CpuidSnapshot *snapshot = source->snapshot;
+  CpuidLeaf l;
+
+  if (snapshot->count >= CpuidSnapshot::CPUID_SNAPSHOT_CAPACITY)
+  {
+    snapshot->truncated = true;
+    return l;
+  }
+
+  if (source->fd < 0)
+    l = cpuid(leaf, subleaf);
+#if defined(__linux__)
+  else
+  {
+    // the cpuid driver takes the leaf in the low and the subleaf in the high
+    // 32 bits of the file offset
+    uint32_t regs[4] = { 0, 0, 0, 0 };
+    off_t offset = static_cast<off_t>(leaf | (static_cast<uint64_t>(subleaf)
+                                              << 32));
+    if (pread(source->fd, regs, sizeof(regs), offset) != sizeof(regs))
+      source->ok = false;
+    l.leaf    = leaf;
+    l.subleaf = subleaf;
+    l.eax     = regs[0];
+    l.ebx     = regs[1];
+    l.ecx     = regs[2];
+    l.edx     = regs[3];
+  }
+#endif
+  snapshot->executed++;
+  snapshot->leaves[snapshot->count++] = l;
+
+  return l;
+}
+
+
+//!
+//! @brief capture one leaf including all of its subleaves
+//!
+static void capture_leaf_all(CpuidSource *source, uint32_t leaf)
+{
+  static constexpr uint32_t maxSubleaf = 63;
+  CpuidLeaf l = capture_leaf(source, leaf, 0);
+
+  switch (leaf)
+  {
+  case 0x00000004: // deterministic cache parameters (until type 0)
+  case 0x8000001D:
+    for (uint32_t i = 1; ((l.eax & 0x1f) != 0) && (i <= maxSubleaf); ++i)
+      l = capture_leaf(source, leaf, i);
+    break;
+  case 0x00000007: // EAX of subleaf 0 is the maximum subleaf
+  case 0x00000014:
+  case 0x00000017:
+  case 0x00000018:
+  case 0x0000001D:
+  case 0x00000020:
+    for (uint32_t i = 1; (i <= l.eax) && (i <= maxSubleaf); ++i)
+      capture_leaf(source, leaf, i);
+    break;
+  case 0x0000000B: // extended topology (until level type 0)
+  case 0x0000001F:
+  case 0x80000026:
+    for (uint32_t i = 1; (((l.ecx >> 8) & 0xff) != 0) && (i <= maxSubleaf);
+         ++i)
+      l = capture_leaf(source, leaf, i);
+    break;
+  case 0x0000000D: // XSAVE state components
+  {
+    uint64_t mask = l.eax | (static_cast<uint64_t>(l.edx) << 32);
+    CpuidLeaf sub1 = capture_leaf(source, leaf, 1);
+    mask |= sub1.ecx | (static_cast<uint64_t>(sub1.edx) << 32);
+    for (uint32_t i = 2; i <= maxSubleaf; ++i)
+      if (mask & (1ULL << i))
+        capture_leaf(source, leaf, i);
+    break;
+  }
+  case 0x0000000F: // RDT monitoring
+    capture_leaf(source, leaf, 1);
+    break;
+  case 0x00000010: // RDT allocation
+  case 0x80000020:
+    for (uint32_t i = 1; i <= 3; ++i)
+      capture_leaf(source, leaf, i);
+    break;
+  case 0x00000012: // SGX (EPC sections until type 0)
+    capture_leaf(source, leaf, 1);
+    for (uint32_t i = 2; i <= maxSubleaf; ++i)
+      if ((capture_leaf(source, leaf, i).eax & 0xf) == 0)
+        break;
+    break;
+  default:
+    break;
+  }
+}
+
+
+//!
+//! @brief capture every leaf from a source
+//!
+static void capture_all(CpuidSource *source)
+{
+  CpuidSnapshot *snapshot = source->snapshot;
+  uint32_t stdLevel, hvLevel, extLevel;
+  CpuidLeaf l;
+
+  snapshot->count     = 0;
+  snapshot->executed  = 0;
+  snapshot->truncated = false;
+
+  l = capture_leaf(source, 0x00000000, 0);
+  stdLevel = l.eax;
+  if (stdLevel > 0xff)
+    stdLevel = 0xff;
+  for (uint32_t leaf = 0x00000001; leaf <= stdLevel; ++leaf)
+    capture_leaf_all(source, leaf);
+
+  // XGETBV is only available when the OS has set CR4.OSXSAVE
+  const CpuidLeaf *std1 = snapshot->find(0x00000001);
+  snapshot->xcr0 = (std1 && (std1->ecx & 0x08000000)) ? get_xcr0() : 0;
+
+  // EAX=0x40000000: hypervisor range (only meaningful under a hypervisor)
+  if (std1 && (std1->ecx & 0x80000000))
+  {
+    l = capture_leaf(source, 0x40000000, 0);
+    hvLevel = l.eax;
+    // KVM reports 0 for a maximum leaf of 40000001H
+    if ((hvLevel < 0x40000001) || (hvLevel > 0x400000ff))
+      hvLevel = 0x40000001;
+    for (uint32_t leaf = 0x40000001; leaf <= hvLevel; ++leaf)
+      capture_leaf_all(source, leaf);
+  }
+
+  l = capture_leaf(source, 0x80000000, 0);
+  extLevel = l.eax;
+  if ((extLevel & 0xffff0000) != 0x80000000)
+    extLevel = 0x80000000;
+  if (extLevel > 0x800000ff)
+    extLevel = 0x800000ff;
+  for (uint32_t leaf = 0x80000001; leaf <= extLevel; ++leaf)
+    capture_leaf_all(source, leaf);
+}
+
+
+void libcpu::capture_cpuid(CpuidSnapshot *snapshot)
+{
+  CpuidSource source;
+
+  source.snapshot = snapshot;
+  capture_all(&source);
+}
+
+
+bool libcpu::capture_cpuid(int cpu, CpuidSnapshot *snapshot)
+{
+  CpuidSource source;
+  vector<int> saved;
+
+  source.snapshot = snapshot;
+
+#if defined(__linux__)
+  // no migration needed when the cpuid driver is loaded and accessible
+  char path[64];
+  snprintf(path, sizeof(path), "/dev/cpu/%d/cpuid", cpu);
+  source.fd = open(path, O_RDONLY);
+  if (source.fd >= 0)
+  {
+    capture_all(&source);
+    close(source.fd);
+    if (source.ok)
+      return true;
+    source.fd = -1;
+    source.ok = true;
+  }
 #endif
+
+  if (!get_thread_affinity(&saved) || !pin_thread(cpu))
+    return false;
+  capture_all(&source);
+  set_thread_affinity(saved);
+
+  return true;
 }
 
 
@@ -199,17 +536,60 @@ static void get_cpuidex(int info[4], int id, int subId)
 }
 
 
+//!
+//! @brief read extended control register 0
+//!
+//! @note caller must check CPUID.01H:ECX.OSXSAVE first
+//!
+static uint64_t get_xcr0()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#elif defined(__GNUC__)
+  uint32_t eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax | (static_cast<uint64_t>(edx) << 32);
+#endif
+}
+
+
+//!
+//! @brief read cpu id from a snapshot
+//!
+//! @param[in]    snapshot  captured leaves
+//! @param[out]   info      EAX, EBX, ECX, and EDX (zero if not captured)
+//! @param[in]    id        function id
+//! @param[in]    subId     sub functional id
+//!
+static void read_cpuid(const CpuidSnapshot &snapshot, int info[4], uint32_t id,
+                       uint32_t subId)
+{
+  const CpuidLeaf *l = snapshot.find(id, subId);
+
+  if (l == nullptr)
+  {
+    info[0] = info[1] = info[2] = info[3] = 0;
+    return;
+  }
+
+  info[0] = static_cast<int>(l->eax);
+  info[1] = static_cast<int>(l->ebx);
+  info[2] = static_cast<int>(l->ecx);
+  info[3] = static_cast<int>(l->edx);
+}
+
+
 //!
 //! @brief EAX=0x0: Maximum supported standard level and vendor ID string
 //!
 //! @return standard level
 //!
-static int detect_stdlevel_00000000(Cpu *cpu)
+static int detect_stdlevel_00000000(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int stdLevel, eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 0);
+  read_cpuid(snapshot, cpuInfo, 0);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -227,12 +607,12 @@ static int detect_stdlevel_00000000(Cpu *cpu)
 //!
 //! @brief EAX=0x1: Processor Info and Feature Bits
 //!
-static void detect_stdlevel_00000001(Cpu *cpu)
+static void detect_stdlevel_00000001(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 1);
+  read_cpuid(snapshot, cpuInfo, 1);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -740,6 +1120,8 @@ static void detect_stdlevel_00000002_partial(Cpu *cpu, uint8_t val)
   case 0xF1: // 128 byte prefetching
     cpu->prefetchSize = 128;
     break;
+  case 0xFE: // query standard level 0000_0018h instead
+    break;
   case 0xFF: // query standard level 0000_0004h instead
     break;
   default:
@@ -752,12 +1134,12 @@ static void detect_stdlevel_00000002_partial(Cpu *cpu, uint8_t val)
 //! @brief EAX=0x2: Cache and TLB Descriptor information
 //! @see http://www.sandpile.org/x86/cpuid.htm#level_0000_0002h
 //!
-static void detect_stdlevel_00000002(Cpu *cpu)
+static void detect_stdlevel_00000002(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 2);
+  read_cpuid(snapshot, cpuInfo, 2);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -794,7 +1176,7 @@ static void detect_stdlevel_00000002(Cpu *cpu)
 //!       processor or later. On all models, use the PSN flag to check for
 //!       PSN support before accessing the feature.
 //!
-static void detect_stdlevel_00000003(Cpu *cpu)
+static void detect_stdlevel_00000003(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   char *serial;
@@ -803,7 +1185,7 @@ static void detect_stdlevel_00000003(Cpu *cpu)
   if (cpu->psn == false)
     return;
 
-  get_cpuid(cpuInfo, 3);
+  read_cpuid(snapshot, cpuInfo, 3);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -825,56 +1207,68 @@ static void detect_stdlevel_00000003(Cpu *cpu)
 }
 
 
+//!
+//! @brief decode one deterministic cache parameters subleaf (leaf 04H and
+//!        8000001DH share the layout)
+//!
+static Cache decode_cache_parameters(int eax, int ebx, int ecx, int edx)
+{
+  Cache cache;
+
+  // eax
+  cache.type                 = (eax >>  0) & 0x1f;
+  cache.level                = (eax >>  5) & 0x7;
+  cache.selfInit             = (eax & 0x00000100) || false;
+  cache.fullAssociative      = (eax & 0x00000200) || false;
+  /* 10-13 reserved */
+  cache.thread               = ((eax >> 14) & 0xfff) + 1;
+  cache.cores                = ((eax >> 26) & 0x3f) + 1;
+
+  // ebx
+  cache.coherencyLineSize    = ((ebx >>  0) & 0xfff) + 1;
+  cache.partition            = ((ebx >> 12) & 0x3ff) + 1;
+  cache.ways                 = ((ebx >> 22) & 0x3ff) + 1;
+
+  // ecx
+  cache.sets                 = ecx + 1;
+
+  // edx
+  cache.writeBackInvalid     = (edx & 0x00000001) || false;
+  cache.inclusiveLowerLevels = (edx & 0x00000002) || false;
+  cache.complexIndexing      = (edx & 0x00000004) || false;
+  /* 3-31 reserved */
+
+  cache.size = (cache.coherencyLineSize * cache.sets * cache.ways) / 1024;
+  cache.shareShift = 0;
+  while ((1 << cache.shareShift) < cache.thread)
+    ++cache.shareShift;
+
+  return cache;
+}
+
+
 //!
 //! @brief EAX=0x4: Cache configuration descriptors
 //!
-static void detect_stdlevel_00000004(Cpu *cpu)
+static void detect_stdlevel_00000004(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  Cache cache;
-
-  if (cpu->monitor == false)
-     return;
 
   for (int i = 0; true; ++i)
   {
-    get_cpuidex(cpuInfo, 4, i);
+    read_cpuid(snapshot, cpuInfo, 4, i);
 
     eax = cpuInfo[0];
     ebx = cpuInfo[1];
     ecx = cpuInfo[2];
     edx = cpuInfo[3];
 
-    if (eax == 0)
+    // type 0: no more caches
+    if ((eax & 0x1f) == 0)
       break;
 
-    // eax
-    cache.type                 = (eax >>  0) & 0x1f;
-    cache.level                = (eax >>  5) & 0x7;
-    cache.selfInit             = (eax & 0x00000100) || false;
-    cache.fullAssociative      = (eax & 0x00000200) || false;
-    /* 10-13 reserved */
-    cache.thread               = ((eax >> 14) & 0xfff) + 1;
-    cache.cores                = ((eax >> 26) & 0x3f) + 1;
-
-    // ebx
-    cache.coherencyLineSize    = ((ebx >>  0) & 0xfff) + 1;
-    cache.partition            = ((ebx >> 12) & 0x3ff) + 1;
-    cache.ways                 = ((ebx >> 22) & 0x3ff) + 1;
-
-    // ecx
-    cache.sets                 = ecx + 1;
-
-    // edx
-    cache.writeBackInvalid     = (edx & 0x00000001) || false;
-    cache.inclusiveLowerLevels = (edx & 0x00000002) || false;
-    cache.complexIndexing      = (edx & 0x00000004) || false;
-    /* 3-31 reserved */
-
-    cache.size = (cache.coherencyLineSize * cache.sets * cache.ways) / 1024;
-
-    cpu->cache.push_back(cache);
+    cpu->cache.push_back(decode_cache_parameters(eax, ebx, ecx, edx));
   }
 }
 
@@ -882,12 +1276,12 @@ static void detect_stdlevel_00000004(Cpu *cpu)
 //!
 //! @brief EAX=0x5: MONITOR/MWAIT
 //!
-static void detect_stdlevel_00000005(Cpu *cpu)
+static void detect_stdlevel_00000005(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 5);
+  read_cpuid(snapshot, cpuInfo, 5);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -921,12 +1315,12 @@ static void detect_stdlevel_00000005(Cpu *cpu)
 //!
 //! @brief EAX=0x6: Thermal and Power Management
 //!
-static void detect_stdlevel_00000006(Cpu *cpu)
+static void detect_stdlevel_00000006(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 6);
+  read_cpuid(snapshot, cpuInfo, 6);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -976,12 +1370,12 @@ static void detect_stdlevel_00000006(Cpu *cpu)
 //!
 //! @brief EAX=0x7: Structured Extended Feature Flags Enumeration Leaf
 //!
-static void detect_stdlevel_00000007(Cpu *cpu)
+static void detect_stdlevel_00000007(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 7);
+  read_cpuid(snapshot, cpuInfo, 7);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -991,95 +1385,98 @@ static void detect_stdlevel_00000007(Cpu *cpu)
     return;
 
   // ebx
-  cpu->fsgsbase                       = (ebx & 0x00000001) ? false : true;
-  cpu->ia32TscAdjustMsr               = (ebx & 0x00000002) ? false : true;
-  cpu->sgx                            = (ebx & 0x00000004) ? false : true;
-  cpu->bmi1                           = (ebx & 0x00000008) ? false : true;
-  cpu->hle                            = (ebx & 0x00000010) ? false : true;
-  cpu->avx2                           = (ebx & 0x00000020) ? false : true;
+  cpu->fsgsbase                       = (ebx & 0x00000001) || false;
+  cpu->ia32TscAdjustMsr               = (ebx & 0x00000002) || false;
+  cpu->sgx                            = (ebx & 0x00000004) || false;
+  cpu->bmi1                           = (ebx & 0x00000008) || false;
+  cpu->hle                            = (ebx & 0x00000010) || false;
+  cpu->avx2                           = (ebx & 0x00000020) || false;
   /* 6 reserved */
-  cpu->smep                           = (ebx & 0x00000080) ? false : true;
-  cpu->bmi2                           = (ebx & 0x00000100) ? false : true;
-  cpu->erms                           = (ebx & 0x00000200) ? false : true;
-  cpu->invpcid                        = (ebx & 0x00000400) ? false : true;
-  cpu->rtm                            = (ebx & 0x00000800) ? false : true;
-  cpu->pqm                            = (ebx & 0x00001000) ? false : true;
-  cpu->fpucsds                        = (ebx & 0x00002000) ? false : true;
-  cpu->mpx                            = (ebx & 0x00004000) ? false : true;
-  cpu->pqe                            = (ebx & 0x00008000) ? false : true;
-  cpu->avx512f                        = (ebx & 0x00010000) ? false : true;
-  cpu->avx512dq                       = (ebx & 0x00020000) ? false : true;
-  cpu->rdseed                         = (ebx & 0x00040000) ? false : true;
-  cpu->adx                            = (ebx & 0x00080000) ? false : true;
-  cpu->smap                           = (ebx & 0x00100000) ? false : true;
-  cpu->avx512ifma                     = (ebx & 0x00200000) ? false : true;
+  cpu->smep                           = (ebx & 0x00000080) || false;
+  cpu->bmi2                           = (ebx & 0x00000100) || false;
+  cpu->erms                           = (ebx & 0x00000200) || false;
+  cpu->invpcid                        = (ebx & 0x00000400) || false;
+  cpu->rtm                            = (ebx & 0x00000800) || false;
+  cpu->pqm                            = (ebx & 0x00001000) || false;
+  cpu->fpucsds                        = (ebx & 0x00002000) || false;
+  cpu->mpx                            = (ebx & 0x00004000) || false;
+  cpu->pqe                            = (ebx & 0x00008000) || false;
+  cpu->avx512f                        = (ebx & 0x00010000) || false;
+  cpu->avx512dq                       = (ebx & 0x00020000) || false;
+  cpu->rdseed                         = (ebx & 0x00040000) || false;
+  cpu->adx                            = (ebx & 0x00080000) || false;
+  cpu->smap                           = (ebx & 0x00100000) || false;
+  cpu->avx512ifma                     = (ebx & 0x00200000) || false;
   /* 22 reserved */
-  cpu->clflushopt                     = (ebx & 0x00800000) ? false : true;
-  cpu->clwb                           = (ebx & 0x01000000) ? false : true;
-  cpu->pt                             = (ebx & 0x02000000) ? false : true;
-  cpu->avx512pf                       = (ebx & 0x04000000) ? false : true;
-  cpu->avx512er                       = (ebx & 0x08000000) ? false : true;
-  cpu->avx512cd                       = (ebx & 0x10000000) ? false : true;
-  cpu->sha                            = (ebx & 0x20000000) ? false : true;
-  cpu->avx512bw                       = (ebx & 0x40000000) ? false : true;
-  cpu->avx512vl                       = (ebx & 0x80000000) ? false : true;
+  cpu->clflushopt                     = (ebx & 0x00800000) || false;
+  cpu->clwb                           = (ebx & 0x01000000) || false;
+  cpu->pt                             = (ebx & 0x02000000) || false;
+  cpu->avx512pf                       = (ebx & 0x04000000) || false;
+  cpu->avx512er                       = (ebx & 0x08000000) || false;
+  cpu->avx512cd                       = (ebx & 0x10000000) || false;
+  cpu->sha                            = (ebx & 0x20000000) || false;
+  cpu->avx512bw                       = (ebx & 0x40000000) || false;
+  cpu->avx512vl                       = (ebx & 0x80000000) || false;
 
   // ecx
-  cpu->prefetchwt1                    = (ecx & 0x00000001) ? false : true;
-  cpu->avx512vbmi                     = (ecx & 0x00000002) ? false : true;
-  cpu->umip                           = (ecx & 0x00000004) ? false : true;
-  cpu->pku                            = (ecx & 0x00000008) ? false : true;
-  cpu->ospke                          = (ecx & 0x00000010) ? false : true;
-  cpu->waitPkg                        = (ecx & 0x00000020) ? false : true;
-  cpu->avx512vbmi2                    = (ecx & 0x00000040) ? false : true;
+  cpu->prefetchwt1                    = (ecx & 0x00000001) || false;
+  cpu->avx512vbmi                     = (ecx & 0x00000002) || false;
+  cpu->umip                           = (ecx & 0x00000004) || false;
+  cpu->pku                            = (ecx & 0x00000008) || false;
+  cpu->ospke                          = (ecx & 0x00000010) || false;
+  cpu->waitPkg                        = (ecx & 0x00000020) || false;
+  cpu->avx512vbmi2                    = (ecx & 0x00000040) || false;
   /* 7 reserved */
-  cpu->gfni                           = (ecx & 0x00000100) ? false : true;
-  cpu->vaes                           = (ecx & 0x00000200) ? false : true;
-  cpu->vpclmulqdq                     = (ecx & 0x00000400) ? false : true;
-  cpu->avx512vnni                     = (ecx & 0x00000800) ? false : true;
-  cpu->avx512bitalg                   = (ecx & 0x00001000) ? false : true;
+  cpu->gfni                           = (ecx & 0x00000100) || false;
+  cpu->vaes                           = (ecx & 0x00000200) || false;
+  cpu->vpclmulqdq                     = (ecx & 0x00000400) || false;
+  cpu->avx512vnni                     = (ecx & 0x00000800) || false;
+  cpu->avx512bitalg                   = (ecx & 0x00001000) || false;
   /* 13 reserved */
-  cpu->avx512vpopcntdq                = (ecx & 0x00004000) ? false : true;
+  cpu->avx512vpopcntdq                = (ecx & 0x00004000) || false;
   /* 14-15 reserved */
   cpu->mawau                          = (ecx >> 17) & 0x1f;
-  cpu->rdpid                          = (ecx & 0x00400000) ? false : true;
+  cpu->rdpid                          = (ecx & 0x00400000) || false;
   /* 23-24 reserved */
-  cpu->cldemote                       = (ecx & 0x02000000) ? false : true;
+  cpu->cldemote                       = (ecx & 0x02000000) || false;
   /* 26 reserved */
-  cpu->movdiri                        = (ecx & 0x08000000) ? false : true;
-  cpu->movdir64b                      = (ecx & 0x10000000) ? false : true;
-  cpu->enqcmd                         = (ecx & 0x20000000) ? false : true;
-  cpu->sgxlc                          = (ecx & 0x40000000) ? false : true;
+  cpu->movdiri                        = (ecx & 0x08000000) || false;
+  cpu->movdir64b                      = (ecx & 0x10000000) || false;
+  cpu->enqcmd                         = (ecx & 0x20000000) || false;
+  cpu->sgxlc                          = (ecx & 0x40000000) || false;
   /* 31 reserved */
 
   // edx
   /* 0-1 reserved */
-  cpu->avx512vnniw                    = (edx & 0x00000002) ? false : true;
-  cpu->avx512fmaps                    = (edx & 0x00000004) ? false : true;
-  cpu->repmov                         = (edx & 0x00000008) ? false : true;
+  cpu->avx512vnniw                    = (edx & 0x00000004) || false;
+  cpu->avx512fmaps                    = (edx & 0x00000008) || false;
+  cpu->repmov                         = (edx & 0x00000010) || false;
   /* 5-7 reserved */
-  cpu->avx512Vp2intersect             = (edx & 0x00000080) ? false : true;
-  /* 9-17 reserved */
-  cpu->pconfig                        = (edx & 0x00040000) ? false : true;
+  cpu->avx512Vp2intersect             = (edx & 0x00000100) || false;
+  /* 9-13 reserved */
+  cpu->serialize                      = (edx & 0x00004000) || false;
+  cpu->hybrid                         = (edx & 0x00008000) || false;
+  /* 16-17 reserved */
+  cpu->pconfig                        = (edx & 0x00040000) || false;
   /* 19-25 reserved */
-  cpu->emuIbrs                        = (edx & 0x04000000) ? false : true;
-  cpu->emuStibp                       = (edx & 0x08000000) ? false : true;
+  cpu->emuIbrs                        = (edx & 0x04000000) || false;
+  cpu->emuStibp                       = (edx & 0x08000000) || false;
   /* 28 reserved */
-  cpu->emuIa32ArchCapabilitiesMsr     = (edx & 0x20000000) ? false : true;
-  cpu->emuIa32CoreCapabilitiesMsr     = (edx & 0x40000000) ? false : true;
-  cpu->emuSsbd                        = (edx & 0x80000000) ? false : true;
+  cpu->emuIa32ArchCapabilitiesMsr     = (edx & 0x20000000) || false;
+  cpu->emuIa32CoreCapabilitiesMsr     = (edx & 0x40000000) || false;
+  cpu->emuSsbd                        = (edx & 0x80000000) || false;
 }
 
 
 //!
 //! @brief EAX=0x9: Direct Cache Access Information
 //!
-static void detect_stdlevel_00000009(Cpu *cpu)
+static void detect_stdlevel_00000009(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 9);
+  read_cpuid(snapshot, cpuInfo, 9);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -1095,12 +1492,12 @@ static void detect_stdlevel_00000009(Cpu *cpu)
 //
 // @brief EAX=0xA: Architectural Performance Monitoring
 //
-static void detect_stdlevel_0000000A(Cpu *cpu)
+static void detect_stdlevel_0000000A(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 0xA);
+  read_cpuid(snapshot, cpuInfo, 0xA);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -1112,7 +1509,8 @@ static void detect_stdlevel_0000000A(Cpu *cpu)
   cpu->widthGpPmc                     = (eax >> 16) & 0xff;
   cpu->lenEbxBit                      = (eax >> 24) & 0xff;
 
-  // ebx
+  // ebx (a set bit means "not available"; only lenEbxBit bits are valid)
+  ebx |= (cpu->lenEbxBit < 32) ? ~((1 << cpu->lenEbxBit) - 1) : 0;
   cpu->cce                            = (ebx & 0x00000001) ? false : true;
   cpu->ire                            = (ebx & 0x00000002) ? false : true;
   cpu->rce                            = (ebx & 0x00000004) ? false : true;
@@ -1133,43 +1531,141 @@ static void detect_stdlevel_0000000A(Cpu *cpu)
 }
 
 //
-// @brief EAX=0x0B: Extended Topology Enumeration Leaf
+// @brief EAX=0x0B/0x1F: Extended Topology Enumeration Leaf
 //
-static void detect_stdlevel_0000000B(Cpu *cpu)
+static void detect_stdlevel_0000000B(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
+  uint32_t leaf = 0xB;
 
-  get_cpuid(cpuInfo, 0xB);
-  eax = cpuInfo[0];
-  ebx = cpuInfo[1];
-  ecx = cpuInfo[2];
-  edx = cpuInfo[3];
+  // V2 extended topology (module/tile/die levels) supersedes leaf 0BH
+  read_cpuid(snapshot, cpuInfo, 0x1F, 0);
+  if ((cpuInfo[1] & 0xffff) != 0)
+    leaf = 0x1F;
 
-  (void)cpu;
+  cpu->topology.clear();
+  for (uint32_t i = 0; true; ++i)
+  {
+    TopologyLevel level;
 
-  // eax
-  (void)eax;
+    read_cpuid(snapshot, cpuInfo, leaf, i);
+    eax = cpuInfo[0];
+    ebx = cpuInfo[1];
+    ecx = cpuInfo[2];
+    edx = cpuInfo[3];
 
-  // ebx
-  (void)ebx;
+    // ecx
+    level.type  = (ecx >>  8) & 0xff;
+    if ((level.type == 0) || (ebx & 0xffff) == 0)
+      break;
 
-  // ecx
-  (void)ecx;
+    // eax
+    level.shift = (eax >>  0) & 0x1f;
+    /* 5-31 reserved */
 
-  // edx
-  (void)edx;
+    // ebx
+    level.count = (ebx >>  0) & 0xffff;
+    /* 16-31 reserved */
+
+    // edx
+    cpu->x2apicId = static_cast<uint32_t>(edx);
+
+    cpu->topology.push_back(level);
+  }
+}
+
+//
+// @brief topology derived from leaf 01H/04H/80000008H for processors
+//        without leaf 0BH
+//
+static void detect_legacy_topology(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+  int logical, cores = 1;
+  TopologyLevel smt, core;
+
+  auto ceil_log2 = [](int n) {
+    int bits = 0;
+    while ((1 << bits) < n)
+      ++bits;
+    return bits;
+  };
+
+  logical = (cpu->htt && (cpu->logicalProcessors > 0)) ?
+              cpu->logicalProcessors : 1;
+
+  // Intel: cores per package from the first deterministic cache leaf
+  read_cpuid(snapshot, cpuInfo, 0x4, 0);
+  if ((cpuInfo[0] & 0x1f) != 0)
+    cores = ((cpuInfo[0] >> 26) & 0x3f) + 1;
+
+  // AMD: cores per package from 80000008H
+  read_cpuid(snapshot, cpuInfo, 0x80000008, 0);
+  if ((cpuInfo[2] & 0xff) != 0)
+    cores = (cpuInfo[2] & 0xff) + 1;
+
+  if ((cores < 1) || (cores > logical))
+    cores = logical;
+
+  smt.type   = 1;
+  smt.shift  = ceil_log2(logical / cores);
+  smt.count  = logical / cores;
+  core.type  = 2;
+  core.shift = ceil_log2(logical);
+  core.count = logical;
+
+  cpu->topology.clear();
+  cpu->topology.push_back(smt);
+  cpu->topology.push_back(core);
+  cpu->x2apicId = static_cast<uint32_t>(cpu->apicId);
+}
+
+//
+// @brief EAX=0x0D: Processor Extended State Enumeration
+//
+static void detect_stdlevel_0000000D(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0xD, 0);
+
+  // eax, edx: supported XCR0 bits
+  cpu->xsaveSupported = static_cast<uint32_t>(cpuInfo[0]) |
+                        (static_cast<uint64_t>(cpuInfo[3]) << 32);
+
+  cpu->xcr0 = snapshot.xcr0;
+}
+
+//
+// @brief EAX=0x15: Time Stamp Counter and Core Crystal Clock Information
+//
+static void detect_stdlevel_00000015(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x15);
+
+  // eax: denominator, ebx: numerator of the TSC/crystal clock ratio
+  cpu->tscRatioDenominator = static_cast<uint32_t>(cpuInfo[0]);
+  cpu->tscRatioNumerator   = static_cast<uint32_t>(cpuInfo[1]);
+
+  // ecx: nominal crystal clock frequency in Hz (0 if not enumerated)
+  cpu->crystalFrequency    = static_cast<uint32_t>(cpuInfo[2]);
+
+  // edx: reserved
 }
 
+
 //
-// @brief EAX=0x9: Direct Cache Access Information
+// @brief EAX=0x16: Processor Frequency Information
 //
-static void detect_stdlevel_00000016(Cpu *cpu)
+static void detect_stdlevel_00000016(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 0x16);
+  read_cpuid(snapshot, cpuInfo, 0x16);
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
@@ -1191,15 +1687,225 @@ static void detect_stdlevel_00000016(Cpu *cpu)
   (void)edx; /* 0-31 reserve */
 }
 
+
+//
+// @brief EAX=0x18: Deterministic Address Translation Parameters
+//
+// @note replaces the leaf 02H TLB descriptors when it enumerates any TLB
+//       (leaf 02H reports descriptor FEH on those processors)
+//
+static void detect_stdlevel_00000018(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int eax, ebx, ecx, edx;
+  int cpuInfo[4];
+  int maxSubleaf;
+  vector<Tlb> tlbs;
+
+  read_cpuid(snapshot, cpuInfo, 0x18, 0);
+  maxSubleaf = cpuInfo[0];
+
+  for (int i = 0; i <= maxSubleaf; ++i)
+  {
+    Tlb tlb;
+
+    read_cpuid(snapshot, cpuInfo, 0x18, i);
+    eax = cpuInfo[0];
+    ebx = cpuInfo[1];
+    ecx = cpuInfo[2];
+    edx = cpuInfo[3];
+
+    // edx type 0: invalid subleaf (later subleaves may still be valid)
+    if ((edx & 0x1f) == 0)
+      continue;
+
+    // eax
+    (void)eax; /* subleaf 0: maximum subleaf, otherwise reserved */
+
+    // ebx
+    tlb.pageSizeFlags   = ebx & 0xf;
+    /* 4-7 reserved, 8-10 partitioning, 11-15 reserved */
+    tlb.ways            = (ebx >> 16) & 0xffff;
+
+    // ecx
+    tlb.sets            = ecx;
+
+    // edx
+    tlb.type            = (edx >> 0) & 0x1f;
+    tlb.level           = (edx >> 5) & 0x7;
+    tlb.fullAssociative = (edx & 0x00000100) || false;
+    /* 9-13 reserved */
+    tlb.thread          = ((edx >> 14) & 0xfff) + 1;
+    /* 26-31 reserved */
+
+    tlb.entories = tlb.ways * tlb.sets;
+    if (tlb.fullAssociative)
+      tlb.ways = 0xff;
+
+    tlbs.push_back(tlb);
+  }
+
+  if (!tlbs.empty())
+    cpu->tlb = tlbs;
+}
+
+
+//
+// @brief EAX=0x1A: Hybrid Information Enumeration
+//
+static void detect_stdlevel_0000001A(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x1A);
+
+  // eax
+  cpu->nativeModelId = static_cast<uint32_t>(cpuInfo[0]) & 0x00ffffff;
+  cpu->coreType      = (static_cast<uint32_t>(cpuInfo[0]) >> 24) & 0xff;
+
+  // ebx, ecx, edx reserved
+}
+
+//
+// @brief EAX=0x40000000: Hypervisor Vendor and Maximum Leaf
+//
+static uint32_t detect_hvlevel_40000000(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  static const struct
+  {
+    const char *signature;
+    int type;
+  } HYPERVISORS[] = { { "KVMKVMKVM", HYPERVISOR_KVM },
+                      { "Microsoft Hv", HYPERVISOR_HYPERV },
+                      { "XenVMMXenVMM", HYPERVISOR_XEN },
+                      { "VMwareVMware", HYPERVISOR_VMWARE } };
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x40000000);
+  memcpy(cpu->hypervisorVendor, &cpuInfo[1], 3 * sizeof(int));
+  cpu->hypervisorVendor[12] = '\0';
+
+  cpu->hypervisorType = HYPERVISOR_OTHER;
+  for (const auto &h : HYPERVISORS)
+    if (strcmp(cpu->hypervisorVendor, h.signature) == 0)
+      cpu->hypervisorType = h.type;
+
+  // KVM reports 0 for a maximum leaf of 40000001H
+  cpu->maxHypervisorLeaf = static_cast<uint32_t>(cpuInfo[0]);
+  if ((cpu->maxHypervisorLeaf < 0x40000001) &&
+      (cpu->hypervisorType == HYPERVISOR_KVM))
+    cpu->maxHypervisorLeaf = 0x40000001;
+
+  return cpu->maxHypervisorLeaf;
+}
+
+//
+// @brief EAX=0x40000001: KVM Paravirtual Features
+//
+static void detect_hvlevel_kvm(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int eax, edx;
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x40000001);
+  eax = cpuInfo[0];
+  edx = cpuInfo[3];
+
+  // eax
+  /* 0-2 legacy clocksource, NOP I/O delay, MMU op */
+  cpu->kvmClocksource2                = (eax & 0x00000008) || false;
+  cpu->kvmAsyncPf                     = (eax & 0x00000010) || false;
+  cpu->kvmStealTime                   = (eax & 0x00000020) || false;
+  cpu->kvmPvEoi                       = (eax & 0x00000040) || false;
+  cpu->kvmPvUnhalt                    = (eax & 0x00000080) || false;
+  /* 8 reserved */
+  cpu->kvmPvTlbFlush                  = (eax & 0x00000200) || false;
+  /* 10 async page fault VM exit */
+  cpu->kvmPvSendIpi                   = (eax & 0x00000800) || false;
+  /* 12 poll control */
+  cpu->kvmPvSchedYield                = (eax & 0x00002000) || false;
+  /* 14-23 */
+  cpu->kvmClocksourceStable           = (eax & 0x01000000) || false;
+  /* 25-31 reserved */
+
+  // edx
+  cpu->kvmHintsRealtime               = (edx & 0x00000001) || false;
+  /* 1-31 reserved */
+}
+
+//
+// @brief EAX=0x40000003/0x40000004: Hyper-V Partition Privileges and
+//        Implementation Recommendations
+//
+static void detect_hvlevel_hyperv(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int eax, ebx;
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x40000003);
+  eax = cpuInfo[0];
+
+  // eax
+  /* 0 VP runtime */
+  cpu->hypervReferenceCounter         = (eax & 0x00000002) || false;
+  cpu->hypervSynic                    = (eax & 0x00000004) || false;
+  cpu->hypervSyntheticTimers          = (eax & 0x00000008) || false;
+  cpu->hypervApicMsrs                 = (eax & 0x00000010) || false;
+  /* 5-8 hypercall, VP index, reset, stats */
+  cpu->hypervReferenceTsc             = (eax & 0x00000200) || false;
+  /* 10 guest idle */
+  cpu->hypervFrequencyMsrs            = (eax & 0x00000800) || false;
+  /* 12-31 */
+
+  read_cpuid(snapshot, cpuInfo, 0x40000004);
+  eax = cpuInfo[0];
+  ebx = cpuInfo[1];
+
+  // eax
+  cpu->hypervRelaxedTiming            = (eax & 0x00000020) || false;
+
+  // ebx
+  cpu->hypervSpinlockRetries          = static_cast<uint32_t>(ebx);
+}
+
+//
+// @brief EAX=0x40000001/0x40000003: Xen Version and Time Information
+//
+static void detect_hvlevel_xen(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x40000001);
+  cpu->xenVersion = static_cast<uint32_t>(cpuInfo[0]);
+
+  // subleaf 0: ECX is the guest TSC frequency (in kHz)
+  read_cpuid(snapshot, cpuInfo, 0x40000003, 0);
+  cpu->hypervisorTscFrequency = static_cast<uint64_t>(
+                                  static_cast<uint32_t>(cpuInfo[2])) * 1000;
+}
+
+//
+// @brief EAX=0x40000010: Hypervisor Timing Information
+//
+static void detect_hvlevel_40000010(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  read_cpuid(snapshot, cpuInfo, 0x40000010);
+  cpu->hypervisorTscFrequency  = static_cast<uint64_t>(
+                                   static_cast<uint32_t>(cpuInfo[0])) * 1000;
+  cpu->hypervisorApicFrequency = static_cast<uint64_t>(
+                                   static_cast<uint32_t>(cpuInfo[1])) * 1000;
+}
+
 //
 // @brief EAX=0x00000000: Maximum supported extended level and vendor ID string
 //
-static int detect_extlevel_80000000(Cpu *cpu)
+static int detect_extlevel_80000000(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int extLevel, eax, ebx, ecx, edx;
   int cpuInfo[4];
 
-  get_cpuid(cpuInfo, 0x80000000);
+  read_cpuid(snapshot, cpuInfo, 0x80000000);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
@@ -1220,11 +1926,11 @@ static int detect_extlevel_80000000(Cpu *cpu)
 //
 // @brief EAX=0x80000001: Extended Processor Signature and Feature Bits.
 //
-static void detect_extlevel_80000001(Cpu *cpu)
+static void detect_extlevel_80000001(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000001, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000001, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
@@ -1248,10 +1954,12 @@ static void detect_extlevel_80000001(Cpu *cpu)
   cpu->misalignedSse               = (ecx & 0x00000080) || false;
   cpu->prefetch3DNow               = (ecx & 0x00000100) || false;
   cpu->skinit                      = (ecx & 0x00001000) || false;
+  cpu->topoExt                     = (ecx & 0x00400000) || false;
 
   // edx
   cpu->sysCallSysRet               = (edx & 0x00000800) || false;
-  cpu->pat                         = (edx & 0x00010000) || false;
+  // AMD mirror of leaf 01H EDX bit 16 (reserved on Intel, so never clear it)
+  cpu->pat                         = cpu->pat || (edx & 0x00010000);
   cpu->amdMmx                      = (edx & 0x00040000) || false;
   cpu->amdFfxsr                    = (edx & 0x00200000) || false;
   cpu->amd1GBPage                  = (edx & 0x00400000) || false;
@@ -1264,72 +1972,130 @@ static void detect_extlevel_80000001(Cpu *cpu)
 //
 // @brief EAX=0x80000002: Brand Name
 //
-static void detect_extlevel_80000002(Cpu *cpu)
+static void detect_extlevel_80000002(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000002, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000002, 0);
   memcpy(cpu->brand, &cpuInfo[0], 4 * sizeof(int));
 }
 
 //
 // @brief EAX=0x80000003: Brand Name
 //
-static void detect_extlevel_80000003(Cpu *cpu)
+static void detect_extlevel_80000003(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000003, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000003, 0);
   memcpy(cpu->brand + 16, &cpuInfo[0], 4 * sizeof(int));
 }
 
 //
 // @brief EAX=0x80000004: Brand Name
 //
-static void detect_extlevel_80000004(Cpu *cpu)
+static void detect_extlevel_80000004(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000004, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000004, 0);
   memcpy(cpu->brand + 32, &cpuInfo[0], 4 * sizeof(int));
 }
 
+//
+// @brief push an AMD L1/L2 TLB entry unless it is absent
+//
+static void push_amd_tlb(Cpu *cpu, int type, int level, int sizeFlags,
+                         int ways, int entories)
+{
+  Tlb tlb;
+
+  if ((entories == 0) || (ways == 0))
+    return;
+
+  tlb.type            = type;
+  tlb.level           = level;
+  tlb.pageSizeFlags   = sizeFlags;
+  tlb.fullAssociative = (ways == 0xff);
+  tlb.ways            = ways;
+  tlb.entories        = entories;
+  tlb.sets            = tlb.fullAssociative ? 1 : (entories / ways);
+  cpu->tlb.push_back(tlb);
+}
+
+//
+// @brief push an AMD legacy cache descriptor unless it is absent
+//
+// @note used only when leaf 8000001DH did not enumerate the caches
+//
+static void push_amd_cache(vector<Cache> *caches, int type, int level,
+                           int size, int ways, int lineSize)
+{
+  Cache cache;
+
+  if ((size == 0) || (ways == 0) || (lineSize == 0))
+    return;
+
+  cache.type              = type;
+  cache.level             = level;
+  cache.size              = size;
+  cache.fullAssociative   = (ways == 0xff);
+  cache.ways              = cache.fullAssociative ? (size * 1024 / lineSize) :
+                                                    ways;
+  cache.coherencyLineSize = lineSize;
+  cache.sets              = (size * 1024) / (cache.ways * lineSize);
+  cache.partition         = 1;
+  caches->push_back(cache);
+}
+
 //
 // @brief L1 cache and L1 TLB configuration descriptors 
 //
-static void detect_extlevel_80000005(Cpu *cpu)
+static void detect_extlevel_80000005(Cpu *cpu, const CpuidSnapshot &snapshot,
+                                     vector<Cache> *caches)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000005, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000005, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
   edx = cpuInfo[3];
 
-  (void)cpu;
-  (void)eax;
-  (void)ebx;
-  (void)ecx;
-  (void)edx;
+  // eax: L1 TLB for 2MB and 4MB pages (entries are halved for 4MB pages)
+  push_amd_tlb(cpu, 1, 1, 0x6, (eax >> 24) & 0xff, (eax >> 16) & 0xff);
+  push_amd_tlb(cpu, 2, 1, 0x6, (eax >>  8) & 0xff, (eax >>  0) & 0xff);
+
+  // ebx: L1 TLB for 4KB pages
+  push_amd_tlb(cpu, 1, 1, 0x1, (ebx >> 24) & 0xff, (ebx >> 16) & 0xff);
+  push_amd_tlb(cpu, 2, 1, 0x1, (ebx >>  8) & 0xff, (ebx >>  0) & 0xff);
+
+  // ecx: L1 data cache (size KB, ways, lines per tag, line size)
+  push_amd_cache(caches, 1, 1, (ecx >> 24) & 0xff, (ecx >> 16) & 0xff,
+                 ecx & 0xff);
+
+  // edx: L1 instruction cache
+  push_amd_cache(caches, 2, 1, (edx >> 24) & 0xff, (edx >> 16) & 0xff,
+                 edx & 0xff);
 }
 
 //
 // @brief EAX=0x80000006 Extended Function CPUID Information
 //
-static void detect_extlevel_80000006(Cpu *cpu)
+static void detect_extlevel_80000006(Cpu *cpu, const CpuidSnapshot &snapshot,
+                                     vector<Cache> *caches)
 {
-#if 0
-  static constexpr int asociate[] =
+  // L2/L3 cache and L2 TLB associativity encoding
+  static constexpr int associate[] =
   {
     0,   // 0000b=disabled
-    0,   // 0001b=undefined
+    1,   // 0001b=direct mapped
     2,   // 0010b=2-way
     3,   // 0011b=3-way
     4,   // 0100b=4-way
     6,   // 0101b=6-way
     8,   // 0110b=8-way
     0,   // 0111b=undefined
-    11,  // 1000b=16-way
-    0,   // 1001b=undefined
+    16,  // 1000b=16-way
+    0,   // 1001b=see leaf 8000001DH
     32,  // 1010b=32-way
     48,  // 1011b=48-way
     64,  // 1100b=64-way
@@ -1337,32 +2103,81 @@ static void detect_extlevel_80000006(Cpu *cpu)
     128, // 1110b=128-way
     255, // 1111b=full
   };
-#endif
 
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000005, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000006, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
   ecx = cpuInfo[2];
   edx = cpuInfo[3];
 
-  (void)cpu;
-  (void)eax;
-  (void)ebx;
-  (void)ecx;
-  (void)edx;
+  // eax: L2 TLB for 2MB and 4MB pages
+  push_amd_tlb(cpu, 1, 2, 0x6, associate[(eax >> 28) & 0xf],
+               (eax >> 16) & 0xfff);
+  push_amd_tlb(cpu, 2, 2, 0x6, associate[(eax >> 12) & 0xf],
+               (eax >>  0) & 0xfff);
+
+  // ebx: L2 TLB for 4KB pages
+  push_amd_tlb(cpu, 1, 2, 0x1, associate[(ebx >> 28) & 0xf],
+               (ebx >> 16) & 0xfff);
+  push_amd_tlb(cpu, 2, 2, 0x1, associate[(ebx >> 12) & 0xf],
+               (ebx >>  0) & 0xfff);
+
+  // ecx: L2 cache (size KB, ways, lines per tag, line size)
+  push_amd_cache(caches, 3, 2, (ecx >> 16) & 0xffff,
+                 associate[(ecx >> 12) & 0xf], ecx & 0xff);
+
+  // edx: L3 cache (size in 512KB units)
+  push_amd_cache(caches, 3, 3, ((edx >> 18) & 0x3fff) * 512,
+                 associate[(edx >> 12) & 0xf], edx & 0xff);
+}
+
+//
+// @brief EAX=0x8000001D: Cache Topology Information
+//
+static void detect_extlevel_8000001D(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+
+  for (int i = 0; true; ++i)
+  {
+    read_cpuid(snapshot, cpuInfo, 0x8000001D, i);
+
+    // type 0: no more caches
+    if ((cpuInfo[0] & 0x1f) == 0)
+      break;
+
+    cpu->cache.push_back(decode_cache_parameters(cpuInfo[0], cpuInfo[1],
+                                                 cpuInfo[2], cpuInfo[3]));
+  }
+}
+
+//
+// @brief EAX=0x80000007 Advanced Power Management Information
+//
+static void detect_extlevel_80000007(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int cpuInfo[4];
+  read_cpuid(snapshot, cpuInfo, 0x80000007, 0);
+
+  // eax, ebx, ecx: reserved or AMD RAS/power reporting
+
+  // edx
+  /* 0-7 AMD power management features */
+  cpu->invariantTsc = (cpuInfo[3] & 0x00000100) || false;
+  /* 9-31 AMD power management features */
 }
 
 //
 // @brief EAX=0x80000008 Extended Function CPUID Information
 //
-static void detect_extlevel_80000008(Cpu *cpu)
+static void detect_extlevel_80000008(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x80000008, 0);
+  read_cpuid(snapshot, cpuInfo, 0x80000008, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
@@ -1380,11 +2195,11 @@ static void detect_extlevel_80000008(Cpu *cpu)
 //
 // @brief EAX=0x8000000A Extended Function CPUID Information
 //
-static void detect_extlevel_8000000A(Cpu *cpu)
+static void detect_extlevel_8000000A(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x8000000A, 0);
+  read_cpuid(snapshot, cpuInfo, 0x8000000A, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
@@ -1417,11 +2232,11 @@ static void detect_extlevel_8000000A(Cpu *cpu)
 //
 // @brief EAX=0x8000001A Extended Function CPUID Information
 //
-static void detect_extlevel_8000001A(Cpu *cpu)
+static void detect_extlevel_8000001A(Cpu *cpu, const CpuidSnapshot &snapshot)
 {
   int eax, ebx, ecx, edx;
   int cpuInfo[4];
-  get_cpuidex(cpuInfo, 0x8000001A, 0);
+  read_cpuid(snapshot, cpuInfo, 0x8000001A, 0);
 
   eax = cpuInfo[0];
   ebx = cpuInfo[1];
@@ -1436,3 +2251,190 @@ static void detect_extlevel_8000001A(Cpu *cpu)
   (void)ecx; /* 0-31 reserve */
   (void)edx; /* 0-31 reserve */
 }
+
+
+//
+// @brief EAX=0x8000001E: Processor Topology Information
+//
+static void detect_extlevel_8000001E(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  int eax, ebx, ecx, edx;
+  int cpuInfo[4];
+  read_cpuid(snapshot, cpuInfo, 0x8000001E, 0);
+
+  eax = cpuInfo[0];
+  ebx = cpuInfo[1];
+  ecx = cpuInfo[2];
+  edx = cpuInfo[3];
+
+  // eax
+  cpu->extendedApicId        = static_cast<uint32_t>(eax);
+
+  // ebx
+  cpu->computeUnitId         = (ebx >> 0) & 0xff;
+  cpu->threadsPerComputeUnit = ((ebx >> 8) & 0xff) + 1;
+  /* 16-31 reserved */
+
+  // ecx
+  cpu->nodeId                = (ecx >> 0) & 0xff;
+  cpu->nodesPerProcessor     = ((ecx >> 8) & 0x7) + 1;
+  /* 11-31 reserved */
+
+  (void)edx; /* 0-31 reserved */
+}
+
+//
+// @brief EAX=0x80000026: AMD Extended CPU Topology
+//
+// @note supersedes leaf 0BH, which has no CCX and CCD levels. The level
+//       types name the container whose children the level's bits count,
+//       so they are mapped one step down onto TopologyLevel::type:
+//       core -> SMT, complex -> core, die -> complex, socket -> die
+//
+static void detect_extlevel_80000026(Cpu *cpu, const CpuidSnapshot &snapshot)
+{
+  static constexpr int levelType[] = { 0, 1, 2, 7, 5 };
+
+  int eax, ebx, ecx, edx;
+  int cpuInfo[4];
+  vector<TopologyLevel> topology;
+
+  for (uint32_t i = 0; true; ++i)
+  {
+    TopologyLevel level;
+    int type;
+
+    read_cpuid(snapshot, cpuInfo, 0x80000026, i);
+    eax = cpuInfo[0];
+    ebx = cpuInfo[1];
+    ecx = cpuInfo[2];
+    edx = cpuInfo[3];
+
+    // ecx
+    type = (ecx >> 8) & 0xff;
+    if ((type == 0) || (type > 4) || (ebx & 0xffff) == 0)
+      break;
+    level.type  = levelType[type];
+
+    // eax
+    level.shift = (eax >> 0) & 0x1f;
+    /* 5-28 reserved, 29-31 core capability flags */
+
+    // ebx
+    level.count = (ebx >> 0) & 0xffff;
+    /* 16-31 power ranking and native model ID */
+
+    // edx
+    cpu->x2apicId = static_cast<uint32_t>(edx);
+
+    topology.push_back(level);
+  }
+
+  if (!topology.empty())
+    cpu->topology = topology;
+}
+
+
+//!
+//! @brief cache instances used by the described processor (needs the
+//!        x2APIC ID, which is decoded after the caches)
+//!
+static void detect_cache_instances(Cpu *cpu)
+{
+  for (Cache &cache : cpu->cache)
+  {
+    cache.instanceId = (cache.shareShift >= 32) ? 0 :
+                         (cpu->x2apicId >> cache.shareShift);
+  }
+}
+
+//!
+//! @brief frequency in Hz from a brand string such as "... @ 3.50GHz"
+//!
+static uint64_t brand_frequency(const char *brand)
+{
+  const char *unit = strstr(brand, "GHz");
+  double scale = 1e9;
+
+  if (unit == nullptr)
+  {
+    unit  = strstr(brand, "MHz");
+    scale = 1e6;
+  }
+  if (unit == nullptr)
+    return 0;
+
+  // walk back over the number in front of the unit
+  const char *begin = unit;
+  while ((begin > brand) &&
+         (((begin[-1] >= '0') && (begin[-1] <= '9')) || (begin[-1] == '.')))
+    --begin;
+  if (begin == unit)
+    return 0;
+
+  return static_cast<uint64_t>(atof(begin) * scale + 0.5);
+}
+
+//!
+//! @brief TSC frequency from leaf 15H, leaf 16H or the brand string
+//!
+static void detect_tsc_frequency(Cpu *cpu)
+{
+  uint64_t numerator   = cpu->tscRatioNumerator;
+  uint64_t denominator = cpu->tscRatioDenominator;
+
+  cpu->tscFrequency       = 0;
+  cpu->tscFrequencySource = 0;
+
+  // the guest TSC may be scaled, so the hypervisor value wins in a VM
+  if (cpu->hypervisorTscFrequency != 0)
+  {
+    cpu->tscFrequency       = cpu->hypervisorTscFrequency;
+    cpu->tscFrequencySource = 4;
+    return;
+  }
+
+  if ((numerator != 0) && (denominator != 0))
+  {
+    if (cpu->crystalFrequency != 0)
+    {
+      cpu->tscFrequency       = cpu->crystalFrequency * numerator /
+                                denominator;
+      cpu->tscFrequencySource = 1;
+      return;
+    }
+
+    // the SDM derives the crystal clock from the base frequency when
+    // leaf 15H does not enumerate it
+    if (cpu->baseFrequency != 0)
+    {
+      cpu->tscFrequency       = static_cast<uint64_t>(cpu->baseFrequency) *
+                                1000000;
+      cpu->crystalFrequency   = cpu->tscFrequency * denominator / numerator;
+      cpu->tscFrequencySource = 2;
+      return;
+    }
+  }
+
+  // the TSC of processors with an invariant TSC runs at the nominal
+  // frequency printed in the brand string (Intel only)
+  if (strcmp(cpu->vendor, "GenuineIntel") == 0)
+  {
+    cpu->tscFrequency = brand_frequency(cpu->brand);
+    if (cpu->tscFrequency != 0)
+      cpu->tscFrequencySource = 3;
+  }
+}
+
+//!
+//! @brief pack the decoded boolean flags into Cpu::features
+//!
+static void detect_feature_set(Cpu *cpu)
+{
+  FeatureSet &features = cpu->features;
+
+  features = FeatureSet();
+#define LIBCPU_FEATURE_SET(name) features.set(Feature::name, cpu->name);
+  LIBCPU_FEATURE_LIST(LIBCPU_FEATURE_SET)
+#undef LIBCPU_FEATURE_SET
+}
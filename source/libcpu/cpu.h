@@ -6,10 +6,78 @@
 #ifndef LIB_CPU_INFO_H
 #define LIB_CPU_INFO_H
 
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
+#include "feature.h"
+
 namespace libcpu {
 
+//!
+//! @brief Raw register values of a single CPUID leaf/subleaf
+//!
+struct CpuidLeaf
+{
+  //! @brief function id (EAX input)
+  uint32_t leaf = 0;
+
+  //! @brief sub function id (ECX input)
+  uint32_t subleaf = 0;
+
+  //! @brief EAX output
+  uint32_t eax = 0;
+
+  //! @brief EBX output
+  uint32_t ebx = 0;
+
+  //! @brief ECX output
+  uint32_t ecx = 0;
+
+  //! @brief EDX output
+  uint32_t edx = 0;
+};
+
+//!
+//! @brief Raw CPUID snapshot of the calling logical processor
+//!
+//! Every standard, hypervisor and extended leaf (and each of their subleaves)
+//! is executed exactly once by capture_cpuid() and stored in ascending
+//! (leaf, subleaf) order. The decoders read only from this table, so the
+//! number of CPUID instructions (and VM exits) per detection is bounded by
+//! CPUID_SNAPSHOT_CAPACITY.
+//!
+struct CpuidSnapshot
+{
+  //! @brief maximum number of leaf/subleaf entries
+  enum { CPUID_SNAPSHOT_CAPACITY = 320 };
+
+  //! @brief captured leaves (sorted by leaf, then subleaf)
+  CpuidLeaf leaves[CPUID_SNAPSHOT_CAPACITY];
+
+  //! @brief number of valid entries in leaves
+  int count = 0;
+
+  //! @brief number of CPUID instructions executed while capturing
+  int executed = 0;
+
+  //! @brief true if some leaves were dropped because the table was full
+  bool truncated = false;
+
+  //! @brief XCR0 read by XGETBV (0 if OSXSAVE is not set)
+  uint64_t xcr0 = 0;
+
+  //!
+  //! @brief find a captured leaf
+  //!
+  //! @param[in]    leaf      function id
+  //! @param[in]    subleaf   sub function id
+  //!
+  //! @return captured entry, or nullptr if the leaf was not captured
+  //!
+  const CpuidLeaf *find(uint32_t leaf, uint32_t subleaf = 0) const;
+};
+
 //!
 //! @brief TLB(Translation Look-aside Buffer) informations
 //!
@@ -20,6 +88,8 @@ struct Tlb
   //!      1: data
   //!      2: instruction
   //!      3: unified
+  //!      4: load only
+  //!      5: store only
   int type = 0;
 
   //! @brief TLB level
@@ -49,8 +119,55 @@ struct Tlb
 
   //! @brief number of entories
   int entories = 0;
+
+  //! @brief number of sets (0 if unknown)
+  int sets = 0;
+
+  //! @brief fully associative ?
+  bool fullAssociative = false;
+
+  //! @brief logical processors sharing this TLB (0 if unknown)
+  int thread = 0;
+};
+
+//!
+//! @brief Core types reported by leaf 1AH on hybrid parts
+//!
+enum CoreType
+{
+  CORE_TYPE_NONE = 0x00,
+
+  //! @brief Intel Atom (E-core)
+  CORE_TYPE_ATOM = 0x20,
+
+  //! @brief Intel Core (P-core)
+  CORE_TYPE_CORE = 0x40
 };
 
+//!
+//! @brief Hypervisors identified by the leaf 40000000H signature
+//!
+enum HypervisorType
+{
+  HYPERVISOR_NONE = 0,
+
+  //! @brief unknown signature
+  HYPERVISOR_OTHER,
+
+  //! @brief Linux KVM ("KVMKVMKVM")
+  HYPERVISOR_KVM,
+
+  //! @brief Microsoft Hyper-V ("Microsoft Hv")
+  HYPERVISOR_HYPERV,
+
+  //! @brief Xen ("XenVMMXenVMM")
+  HYPERVISOR_XEN,
+
+  //! @brief VMware ("VMwareVMware")
+  HYPERVISOR_VMWARE
+};
+
+
 //!
 //! @brief Cache informations
 //!
@@ -102,6 +219,45 @@ struct Cache
 
   //! @brief complex indexing?
   bool complexIndexing = false;
+
+  //! @brief low x2APIC ID bits that address the logical processors sharing
+  //!        one instance of this cache (= ceil(log2(thread)))
+  int shareShift = 0;
+
+  //! @brief instance of this cache used by the described logical processor
+  //!        (x2APIC ID >> shareShift, unique within the system per level
+  //!        and type)
+  uint32_t instanceId = 0;
+
+  //! @brief OS logical processors sharing that instance, ascending. Empty
+  //!        until filled by assign_cache_sharing() or detect_cpu_info_all()
+  std::vector<int> sharedCpus;
+};
+
+//!
+//! @brief Processor topology level (leaf 0BH/1FH/80000026H subleaf)
+//!
+struct TopologyLevel
+{
+  //! @brief level type
+  //!      0: invalid
+  //!      1: SMT
+  //!      2: core
+  //!      3: module
+  //!      4: tile
+  //!      5: die (AMD CCD)
+  //!      6: die group
+  //!      7: core complex (AMD CCX, leaf 80000026H only)
+  int type = 0;
+
+  //! @brief Number of bits to shift right on x2APIC ID to get a unique
+  //!        topology ID of the next level type. All logical processors with
+  //!        the same next level ID share current level
+  int shift = 0;
+
+  //! @brief Number of logical processors at this level type. The number
+  //!        reflects configuration as shipped by Intel
+  int count = 0;
 };
 
 //!
@@ -113,6 +269,13 @@ struct Cache
 //!
 struct Cpu
 {
+  //! @brief Every boolean feature flag below packed into one bit set
+  FeatureSet features;
+
+  //! @brief OS logical processor the snapshot was captured on (-1: the
+  //!        calling thread, wherever it was scheduled)
+  int cpuIndex = -1;
+
   //! @brief Vendor ID string
   char vendor[32] = "";
 
@@ -185,6 +348,26 @@ struct Cpu
   //!        monitoring events
   int lenEbxBit = 0;
 
+  //! @brief TSC/crystal clock ratio denominator (leaf 15H EAX)
+  uint32_t tscRatioDenominator = 0;
+
+  //! @brief TSC/crystal clock ratio numerator (leaf 15H EBX)
+  uint32_t tscRatioNumerator = 0;
+
+  //! @brief Nominal core crystal clock frequency (in Hz, 0 if unknown)
+  uint64_t crystalFrequency = 0;
+
+  //! @brief TSC frequency (in Hz, 0 if unknown)
+  uint64_t tscFrequency = 0;
+
+  //! @brief Where tscFrequency came from
+  //!      0: unknown
+  //!      1: leaf 15H crystal clock and ratio
+  //!      2: leaf 15H ratio and leaf 16H base frequency
+  //!      3: brand string
+  //!      4: hypervisor (leaf 40000010H or the Xen time leaf)
+  int tscFrequencySource = 0;
+
   //! @brief Processor Base Frequency (in MHz)
   int baseFrequency = 0;
 
@@ -691,6 +874,12 @@ struct Cpu
   //! @brief AVX512_VP2INTERSECT
   bool avx512Vp2intersect = false;
 
+  //! @brief SERIALIZE instruction
+  bool serialize = false;
+
+  //! @brief Hybrid part (P-cores and E-cores in one package)
+  bool hybrid = false;
+
   //! @brief PCONFIG
   bool pconfig = false;
 
@@ -755,22 +944,127 @@ struct Cpu
 
   //
   //
-  // 0BH Direct Architectural Performance Monitoring Leaf
+  // 0BH/1FH Extended Topology Enumeration Leaf
   //
   //
 
-  //! @brief Number of bits to shift right on x2APIC ID to get a unique topology
-  //!        ID of the next level type. All logical processors with the same
-  //!        next level ID share current level
+  //! @brief x2APIC ID of the current logical processor
+  uint32_t x2apicId = 0;
 
-  //! @brief Number of logical processors at this level type. The number
-  //!        reflects configuration as shipped by Intel
+  //! @brief Topology levels ordered from SMT upwards (leaf 80000026H on AMD,
+  //!        leaf 1FH if available, otherwise leaf 0BH, otherwise derived
+  //!        from leaf 01H/04H)
+  std::vector<TopologyLevel> topology;
 
-  //! @brief Branch mispredict retired event available
+  //
+  //
+  // 0DH Processor Extended State Enumeration Leaf
+  //
+  //
 
-  //! @brief Branch mispredict retired event available
+  //! @brief XSAVE state components supported by the processor (XCR0 bits)
+  uint64_t xsaveSupported = 0;
+
+  //! @brief State components enabled by the OS (XCR0 read by XGETBV)
+  //!          bit 1: SSE, bit 2: AVX, bit 5-7: AVX-512 opmask/ZMM
+  uint64_t xcr0 = 0;
+
+  //
+  //
+  // 1AH Hybrid Information Enumeration Leaf
+  //
+  //
+
+  //! @brief Core type of this logical processor (CoreType, 0 if not hybrid)
+  int coreType = CORE_TYPE_NONE;
+
+  //! @brief Native model ID of the core type
+  uint32_t nativeModelId = 0;
+
+  //
+  //
+  // 40000000H Hypervisor Leaves
+  //
+  //
+
+  //! @brief Hypervisor (HypervisorType, 0 on bare metal)
+  int hypervisorType = HYPERVISOR_NONE;
+
+  //! @brief Hypervisor vendor signature
+  char hypervisorVendor[16] = "";
+
+  //! @brief Maximum hypervisor leaf
+  uint32_t maxHypervisorLeaf = 0;
+
+  //! @brief TSC frequency provided by the hypervisor (in Hz)
+  uint64_t hypervisorTscFrequency = 0;
+
+  //! @brief Local APIC timer frequency provided by the hypervisor (in Hz)
+  uint64_t hypervisorApicFrequency = 0;
+
+  //! @brief KVM: kvmclock (MSRs 4B564D00H/4B564D01H)
+  bool kvmClocksource2 = false;
+
+  //! @brief KVM: asynchronous page faults
+  bool kvmAsyncPf = false;
+
+  //! @brief KVM: steal time accounting
+  bool kvmStealTime = false;
+
+  //! @brief KVM: paravirtual EOI
+  bool kvmPvEoi = false;
+
+  //! @brief KVM: paravirtual spinlocks (halted vCPUs can be kicked)
+  bool kvmPvUnhalt = false;
+
+  //! @brief KVM: paravirtual TLB flush
+  bool kvmPvTlbFlush = false;
 
+  //! @brief KVM: paravirtual send IPI
+  bool kvmPvSendIpi = false;
 
+  //! @brief KVM: paravirtual sched yield
+  bool kvmPvSchedYield = false;
+
+  //! @brief KVM: kvmclock is stable across vCPUs
+  bool kvmClocksourceStable = false;
+
+  //! @brief KVM: vCPUs are never preempted (dedicated physical CPUs)
+  bool kvmHintsRealtime = false;
+
+  //! @brief Hyper-V: partition reference counter (time reference count MSR)
+  bool hypervReferenceCounter = false;
+
+  //! @brief Hyper-V: synthetic interrupt controller
+  bool hypervSynic = false;
+
+  //! @brief Hyper-V: synthetic timers
+  bool hypervSyntheticTimers = false;
+
+  //! @brief Hyper-V: APIC access MSRs
+  bool hypervApicMsrs = false;
+
+  //! @brief Hyper-V: reference TSC page
+  bool hypervReferenceTsc = false;
+
+  //! @brief Hyper-V: TSC and APIC frequency MSRs
+  bool hypervFrequencyMsrs = false;
+
+  //! @brief Hyper-V: relaxed timing (no watchdog timeouts) recommended
+  bool hypervRelaxedTiming = false;
+
+  //! @brief Hyper-V: spinlock retries before notifying the hypervisor
+  //!        (0xffffffff: never notify)
+  uint32_t hypervSpinlockRetries = 0;
+
+  //! @brief Xen: version (major << 16 | minor)
+  uint32_t xenVersion = 0;
+
+  //
+  //
+  // 80000001H Extended Processor Signature and Feature Bits
+  //
+  //
 
   //! @brief LAHF and SAHF in PM64
   bool ahf64 = false;
@@ -802,6 +1096,9 @@ struct Cpu
   //! @brief SKINIT and STGI
   bool skinit = false;
 
+  //! @brief Topology extensions (leaf 8000001DH/8000001EH)
+  bool topoExt = false;
+
   //! @brief SYSCALL and SYSRET instructions
   bool sysCallSysRet = false;
 
@@ -829,6 +1126,16 @@ struct Cpu
   //! @brief 3DNow!™ instructions 
   bool amd3DNow = false;
 
+  //
+  //
+  // 80000007H Advanced Power Management Information
+  //
+  //
+
+  //! @brief Invariant TSC: the TSC runs at a constant rate in all ACPI P-,
+  //!        C- and T-states
+  bool invariantTsc = false;
+
   //! @brief number of address space identifiers (ASID) 
   int amdSvmRev = 0;
 
@@ -870,20 +1177,239 @@ struct Cpu
 
   //! @brief MOVU SSE
   bool amdMoveu = false;
+
+  //
+  //
+  // 8000001EH Processor Topology Information
+  //
+  //
+
+  //! @brief extended APIC ID (x2APIC ID when x2APIC is enabled)
+  uint32_t extendedApicId = 0;
+
+  //! @brief compute unit ID (core ID on Zen, unique within the node)
+  int computeUnitId = 0;
+
+  //! @brief threads per compute unit
+  int threadsPerComputeUnit = 0;
+
+  //! @brief node ID of the logical processor
+  int nodeId = 0;
+
+  //! @brief nodes per processor
+  int nodesPerProcessor = 0;
 };
 
 
+//!
+//! @brief features of a cpu that can actually be executed (see
+//!        usable_features(const FeatureSet &, uint64_t))
+//!
+inline FeatureSet usable_features(const Cpu &cpu)
+{
+  return usable_features(cpu.features, cpu.xcr0);
+}
+
+
+//!
+//! @brief query a feature, folded to true at compile time when the build
+//!        target already guarantees it
+//!
+//! @code
+//!   if (libcpu::has<libcpu::Feature::avx2>(cpu)) // constant with -mavx2
+//! @endcode
+//!
+//! At run time, AVX and AVX-512 features also need their XCR0 state.
+//!
+template <Feature F>
+inline bool has(const Cpu &cpu)
+{
+  return std::integral_constant<bool, feature_compiled(F)>::value ||
+         usable_features(cpu).has(F);
+}
+
+//!
+//! @brief query several features, skipping those guaranteed at compile time
+//!
+template <Feature... F>
+inline bool has_all(const Cpu &cpu)
+{
+  constexpr FeatureSet runtime = FeatureSet{ F... } - compiled_features();
+  return runtime.empty() || usable_features(cpu).has_all(runtime);
+}
+
+//!
+//! @brief query a feature set, skipping those guaranteed at compile time
+//!
+inline bool has_all(const Cpu &cpu, const FeatureSet &mask)
+{
+  return usable_features(cpu).has_all(mask - compiled_features());
+}
+
+//!
+//! @brief logical processors are not time-shared with other guests, so busy
+//!        waiting does not burn the time slice of a preempted vCPU
+//!
+//! @return true on bare metal and on KVM with the realtime hint
+//!
+inline bool dedicated_cpus(const Cpu &cpu)
+{
+  return !cpu.hypervisor || cpu.kvmHintsRealtime;
+}
+
+//!
+//! @brief execute a single CPUID instruction on the calling thread
+//!
+//! @param[in]    leaf      function id
+//! @param[in]    subleaf   sub function id
+//!
+//! @return register values
+//!
+CpuidLeaf cpuid(uint32_t leaf, uint32_t subleaf = 0);
+
+
+//!
+//! @brief execute CPUID once for every supported leaf and subleaf
+//!
+//! @param[out]   snapshot    captured leaves
+//!
+void capture_cpuid(CpuidSnapshot *snapshot);
+
+
+//!
+//! @brief capture the snapshot of another logical processor
+//!
+//! Reads /dev/cpu/N/cpuid when the Linux cpuid driver is accessible,
+//! otherwise pins the calling thread to the processor for the duration of
+//! the capture and restores its affinity.
+//!
+//! @param[in]    cpu         OS logical processor number
+//! @param[out]   snapshot    captured leaves (XCR0 is read on the caller)
+//!
+//! @return true on success
+//!
+bool capture_cpuid(int cpu, CpuidSnapshot *snapshot);
+
+
 //!
 //! @brief cpu infomation detection
 //!
+//! @note equivalent to capture_cpuid() followed by detect_cpu_info(cpu, snap)
+//!
 void detect_cpu_info(Cpu *cpu);
 
 
+//!
+//! @brief cpu infomation detection from a captured snapshot
+//!
+//! @param[out]   cpu         decoded cpu information
+//! @param[in]    snapshot    snapshot taken by capture_cpuid()
+//!
+void detect_cpu_info(Cpu *cpu, const CpuidSnapshot &snapshot);
+
+
+//!
+//! @brief process-wide cpu information
+//!
+//! The first call runs detect_cpu_info() once under a one-time
+//! initialization guard; later calls are a single acquire load. If the
+//! LIBCPU_SNAPSHOT_CACHE environment variable names a file, the detection
+//! goes through detect_cpu_info_cached() (see snapcache.h).
+//!
+//! @return detection result shared by every thread (valid until exit)
+//!
+const Cpu &current();
+
+
+//!
+//! @brief re-run the detection and publish it to current()
+//!
+//! The snapshot cache is bypassed.
+//!
+//! @note references obtained before the refresh stay valid and keep the
+//!       previous result
+//!
+//! @return new detection result
+//!
+const Cpu &refresh();
+
+
+//!
+//! @brief run the detection on every logical processor the process may use
+//!
+//! Each processor is captured by its own worker thread, pinned to it or
+//! reading /dev/cpu/N/cpuid. On hybrid parts the entries differ in coreType,
+//! caches and features. Cache::sharedCpus is filled for every entry.
+//!
+//! @param[out]   cpus    one entry per processor in ascending cpuIndex order;
+//!                       entries that could not be captured keep cpuIndex -1
+//!
+//! @return true if every processor was captured
+//!
+bool detect_cpu_info_all(std::vector<Cpu> *cpus);
+
+
+//!
+//! @brief OS logical processor numbers of one core type
+//!
+//! @param[in]    cpus      result of detect_cpu_info_all()
+//! @param[in]    coreType  CORE_TYPE_ATOM, CORE_TYPE_CORE or CORE_TYPE_NONE
+//!
+//! @return processor numbers usable with pin_thread()
+//!
+std::vector<int> cpus_of_core_type(const std::vector<Cpu> &cpus,
+                                   int coreType);
+
+
+//!
+//! @brief query a feature of current(), folded to true at compile time when
+//!        the build target already guarantees it
+//!
+template <Feature F>
+inline bool has()
+{
+  return std::integral_constant<bool, feature_compiled(F)>::value ||
+         usable_features(current()).has(F);
+}
+
+
+//!
+//! @brief x86-64 micro-architecture level supported by the cpu and the OS
+//!
+//! @return 0: not x86-64
+//!         1: x86-64 (baseline)
+//!         2: x86-64-v2
+//!         3: x86-64-v3 (requires AVX state enabled in XCR0)
+//!         4: x86-64-v4 (requires AVX-512 state enabled in XCR0)
+//!
+int isa_level(const Cpu &cpu);
+
+
+//!
+//! @brief x86-64 micro-architecture level of current()
+//!
+int isa_level();
+
+
+//!
+//! @brief name of an isa_level() value ("x86-64-v3", ...)
+//!
+const char *isa_level_name(int level);
+
+
 //!
 //! @brief print cpuid
 //!
 void print_cpuid();
 
+
+//!
+//! @brief print cpuid of a captured snapshot
+//!
+//! @param[in]    snapshot    snapshot taken by capture_cpuid()
+//!
+void print_cpuid(const CpuidSnapshot &snapshot);
+
 } // namespace libcpu
 
 #endif // LIB_CPU_INFO_H
\ No newline at end of file
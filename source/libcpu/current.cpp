@@ -0,0 +1,72 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#include "cpu.h"
+#include "snapcache.h"
+
+using namespace std;
+using namespace libcpu;
+
+//! @brief published detection result (constant-initialized, never freed)
+static atomic<const Cpu *> currentCpu(nullptr);
+
+//! @brief guard of the first detection
+static once_flag currentOnce;
+
+//! @brief serializes refresh()
+static mutex currentMutex;
+
+
+//!
+//! @brief run a detection into a new heap instance and publish it
+//!
+//! @param[in]    useCache  go through the snapshot cache named by the
+//!                         LIBCPU_SNAPSHOT_CACHE environment variable
+//!
+//! @note Previous instances are intentionally leaked: callers may still hold
+//!       references returned by current(), and refresh() is expected to be
+//!       called only a handful of times per process.
+//!
+static const Cpu *publish_current(bool useCache)
+{
+  Cpu *cpu = new Cpu;
+  const char *path = useCache ? getenv("LIBCPU_SNAPSHOT_CACHE") : nullptr;
+
+  if ((path != nullptr) && (path[0] != '\0'))
+    detect_cpu_info_cached(cpu, path);
+  else
+    detect_cpu_info(cpu);
+  currentCpu.store(cpu, memory_order_release);
+
+  return cpu;
+}
+
+
+const Cpu &libcpu::current()
+{
+  const Cpu *cpu = currentCpu.load(memory_order_acquire);
+
+  if (cpu != nullptr)
+    return *cpu;
+
+  call_once(currentOnce, []() {
+    lock_guard<mutex> lock(currentMutex);
+    if (currentCpu.load(memory_order_relaxed) == nullptr)
+      publish_current(true);
+  });
+
+  return *currentCpu.load(memory_order_acquire);
+}
+
+
+const Cpu &libcpu::refresh()
+{
+  lock_guard<mutex> lock(currentMutex);
+
+  return *publish_current(false);
+}
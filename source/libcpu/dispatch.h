@@ -0,0 +1,156 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_DISPATCH_H
+#define LIB_CPU_DISPATCH_H
+
+#include <cstring>
+#include <vector>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief One implementation of a multiversioned function
+//!
+template <typename Fn>
+struct DispatchCandidate
+{
+  //! @brief implementation
+  Fn fn = nullptr;
+
+  //! @brief features the implementation requires
+  FeatureSet required;
+
+  //! @brief higher priority wins among the supported candidates
+  int priority = 0;
+
+  //! @brief name used by the override and for diagnostics
+  const char *name = "";
+};
+
+//!
+//! @brief Runtime function multiversioning
+//!
+//! Implementations are registered with the features they require and a
+//! priority. resolve() picks the supported candidate with the highest priority
+//! once and returns a plain function pointer, so every later call is a single
+//! indirect call without feature branches.
+//!
+//! @code
+//!   static int sum_avx2(const int *, int);
+//!   static int sum_sse2(const int *, int);
+//!   static int sum_c(const int *, int);
+//!
+//!   static auto sum = libcpu::Dispatcher<int (*)(const int *, int)>()
+//!     .add(sum_avx2, { libcpu::Feature::avx2 }, 20, "avx2")
+//!     .add(sum_sse2, { libcpu::Feature::sse2 }, 10, "sse2")
+//!     .add(sum_c, {}, 0, "c")
+//!     .resolve();
+//! @endcode
+//!
+template <typename Fn>
+class Dispatcher
+{
+public:
+  //!
+  //! @brief register an implementation
+  //!
+  //! @param[in]    fn        implementation
+  //! @param[in]    required  features the implementation needs
+  //! @param[in]    priority  higher value is preferred
+  //! @param[in]    name      candidate name (static storage)
+  //!
+  Dispatcher &add(Fn fn, const FeatureSet &required, int priority,
+                  const char *name = "")
+  {
+    DispatchCandidate<Fn> c;
+    c.fn       = fn;
+    c.required = required;
+    c.priority = priority;
+    c.name     = name;
+    candidates.push_back(c);
+    return *this;
+  }
+
+  //!
+  //! @brief force a candidate by name regardless of the cpu features
+  //!
+  //! @param[in]    name      candidate name, nullptr to clear the override
+  //!
+  //! @note intended for tests; takes effect on the next resolve()
+  //!
+  Dispatcher &set_override(const char *name)
+  {
+    forced = name;
+    return *this;
+  }
+
+  //!
+  //! @brief select the best implementation for the running cpu
+  //!
+  //! AVX and AVX-512 candidates are only considered when the OS has enabled
+  //! their register state (see usable_features()).
+  //!
+  //! @return selected implementation, nullptr if no candidate is supported
+  //!
+  Fn resolve() { return resolve(usable_features(current())); }
+
+  //!
+  //! @brief select the best implementation for a given feature set
+  //!
+  //! @param[in]    available features assumed to be present
+  //!
+  //! @return selected implementation, nullptr if no candidate is supported
+  //!
+  Fn resolve(const FeatureSet &available)
+  {
+    const DispatchCandidate<Fn> *best = nullptr;
+
+    for (const DispatchCandidate<Fn> &c : candidates)
+    {
+      if (forced != nullptr)
+      {
+        if (strcmp(c.name, forced) == 0)
+        {
+          best = &c;
+          break;
+        }
+        continue;
+      }
+      if (!available.has_all(c.required))
+        continue;
+      if ((best == nullptr) || (c.priority > best->priority))
+        best = &c;
+    }
+
+    selected     = best ? best->fn : nullptr;
+    selectedName = best ? best->name : nullptr;
+    return selected;
+  }
+
+  //! @brief implementation chosen by the last resolve()
+  Fn get() const { return selected; }
+
+  //! @brief name of the implementation chosen by the last resolve()
+  const char *get_name() const { return selectedName; }
+
+  //! @brief registered implementations
+  const std::vector<DispatchCandidate<Fn>> &get_candidates() const
+  {
+    return candidates;
+  }
+
+private:
+  std::vector<DispatchCandidate<Fn>> candidates;
+  const char *forced       = nullptr;
+  Fn selected              = nullptr;
+  const char *selectedName = nullptr;
+};
+
+} // namespace libcpu
+
+#endif // LIB_CPU_DISPATCH_H
@@ -0,0 +1,522 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_FEATURE_H
+#define LIB_CPU_FEATURE_H
+
+#include <cstdint>
+#include <initializer_list>
+
+//!
+//! @brief list of every boolean feature flag of libcpu::Cpu
+//!
+//! Each entry is X(name) where name is both the Feature enumerator and the
+//! matching Cpu member. New flags must be appended to keep bit positions (and
+//! therefore serialized FeatureSet values) stable.
+//!
+#define LIBCPU_FEATURE_LIST(X)                                                 \
+  /* 01H ECX */                                                                \
+  X(sse3) X(pclmulqdq) X(dtes64) X(monitor) X(dscpl) X(vmx) X(smx) X(est)      \
+  X(tm2) X(ssse3) X(cnxtid) X(sdbg) X(fma) X(cx16) X(xtpr) X(pdcm) X(pcid)     \
+  X(dca) X(sse41) X(sse42) X(x2apic) X(movebe) X(popcnt) X(tscDeadline) X(ase) \
+  X(xsave) X(osxsave) X(avx) X(f16c) X(rdrnd) X(hypervisor)                    \
+  /* 01H EDX */                                                                \
+  X(fpu) X(mve) X(de) X(pse) X(tsc) X(msr) X(pae) X(mce) X(cx8) X(apic) X(sep) \
+  X(mttr) X(pge) X(mca) X(cmov) X(pat) X(pse36) X(psn) X(clfsh) X(ds) X(acpi)  \
+  X(mmx) X(fxsr) X(sse) X(sse2) X(ss) X(htt) X(tm) X(ia64) X(pbe)              \
+  /* 05H */                                                                    \
+  X(es) X(ib)                                                                  \
+  /* 06H */                                                                    \
+  X(digitalTempSensor) X(turboBoost) X(arat) X(pln) X(ecmd) X(ptm) X(hwp)      \
+  X(hwpNotification) X(hwpActivityWindow) X(hwpEnergyPerformancePreference)    \
+  X(hwpPackageLevelRequest) X(hdc) X(turboBoostMax3) X(hwpCapabilities)        \
+  X(hwpPeci) X(flexHwp) X(fastAccessMode) X(hwFeedback) X(ignoringIdle)        \
+  X(hwCoordinationFeedbackCapability) X(performanceEnergyBiasPreference)       \
+  /* 07H */                                                                    \
+  X(fsgsbase) X(ia32TscAdjustMsr) X(sgx) X(bmi1) X(hle) X(avx2) X(smep)        \
+  X(bmi2) X(erms) X(invpcid) X(rtm) X(pqm) X(fpucsds) X(mpx) X(pqe)            \
+  X(avx512f) X(avx512dq) X(rdseed) X(adx) X(smap) X(avx512ifma) X(clflushopt)  \
+  X(clwb) X(pt) X(avx512pf) X(avx512er) X(avx512cd) X(sha) X(avx512bw)         \
+  X(avx512vl) X(prefetchwt1) X(avx512vbmi) X(umip) X(pku) X(ospke) X(waitPkg)  \
+  X(avx512vbmi2) X(gfni) X(vaes) X(vpclmulqdq) X(avx512vnni) X(avx512bitalg)   \
+  X(avx512vpopcntdq) X(rdpid) X(cldemote) X(movdiri) X(movdir64b) X(enqcmd)    \
+  X(sgxlc) X(avx512vnniw) X(avx512fmaps) X(repmov) X(avx512Vp2intersect)       \
+  X(pconfig) X(emuIbrs) X(emuStibp) X(emuIa32ArchCapabilitiesMsr)              \
+  X(emuIa32CoreCapabilitiesMsr) X(emuSsbd)                                     \
+  /* 0AH */                                                                    \
+  X(cce) X(ire) X(rce) X(llcre) X(llcme) X(bire) X(bmre)                       \
+  /* 80000001H */                                                              \
+  X(ahf64) X(cmpLegacy) X(svm) X(extApicSpace) X(altMovCr8) X(lzcnt) X(sse4a)  \
+  X(misalignedSse) X(prefetch3DNow) X(skinit) X(sysCallSysRet) X(amdMmx)       \
+  X(amdFfxsr) X(amd1GBPage) X(rdtscp) X(amdLm) X(amd3DNowExt) X(amd3DNow)      \
+  /* 8000000AH */                                                              \
+  X(amdNp) X(amdLbr) X(amdSvml) X(amdNrips) X(amdTscRateMsr) X(amdVmcbClean)   \
+  X(amdFlushByAsid) X(amdDecodeAssists) X(amdPauseFilter)                      \
+  X(amdPauseFilterThresh)                                                      \
+  /* 8000001AH */                                                              \
+  X(amdFp128) X(amdMoveu)                                                      \
+  /* appended after the initial list to keep the enum values stable */         \
+  X(hybrid) X(topoExt) X(invariantTsc) X(serialize)                            \
+  /* 40000001H (KVM) */                                                        \
+  X(kvmClocksource2) X(kvmAsyncPf) X(kvmStealTime) X(kvmPvEoi) X(kvmPvUnhalt)  \
+  X(kvmPvTlbFlush) X(kvmPvSendIpi) X(kvmPvSchedYield) X(kvmClocksourceStable)  \
+  X(kvmHintsRealtime)                                                          \
+  /* 40000003H (Hyper-V) */                                                    \
+  X(hypervReferenceCounter) X(hypervSynic) X(hypervSyntheticTimers)            \
+  X(hypervApicMsrs) X(hypervReferenceTsc) X(hypervFrequencyMsrs)               \
+  X(hypervRelaxedTiming)
+
+namespace libcpu {
+
+//!
+//! @brief CPU feature identifier (bit position in FeatureSet)
+//!
+enum class Feature : int
+{
+#define LIBCPU_FEATURE_ENUM(name) name,
+  LIBCPU_FEATURE_LIST(LIBCPU_FEATURE_ENUM)
+#undef LIBCPU_FEATURE_ENUM
+  count
+};
+
+//!
+//! @brief Packed set of CPU features
+//!
+//! One bit per Feature, packed into FEATURE_WORDS 64 bit words (32 bytes).
+//! Queries and set operations work word by word without branches, so
+//! compilers turn them into a couple of (vector) instructions.
+//!
+//! @note not over-aligned on purpose: Cpu must stay usable with the C++14
+//!       operator new and std::vector
+//!
+struct FeatureSet
+{
+  //! @brief number of 64 bit words
+  enum { FEATURE_WORDS = 4 };
+
+  //! @brief feature bits (bit n of words[n / 64] is Feature n)
+  uint64_t words[FEATURE_WORDS] = { 0, 0, 0, 0 };
+
+  constexpr FeatureSet() = default;
+
+  //!
+  //! @brief build a set from a list of features
+  //!
+  constexpr FeatureSet(std::initializer_list<Feature> list)
+  {
+    for (Feature f : list)
+      set(f);
+  }
+
+  //!
+  //! @brief test a single feature
+  //!
+  constexpr bool has(Feature f) const
+  {
+    return ((words[index(f) >> 6] >> (index(f) & 63)) & 1) != 0;
+  }
+
+  //!
+  //! @brief test that every feature of mask is present
+  //!
+  constexpr bool has_all(const FeatureSet &mask) const
+  {
+    return (((words[0] & mask.words[0]) ^ mask.words[0]) |
+            ((words[1] & mask.words[1]) ^ mask.words[1]) |
+            ((words[2] & mask.words[2]) ^ mask.words[2]) |
+            ((words[3] & mask.words[3]) ^ mask.words[3])) == 0;
+  }
+
+  //!
+  //! @brief test that at least one feature of mask is present
+  //!
+  constexpr bool has_any(const FeatureSet &mask) const
+  {
+    return ((words[0] & mask.words[0]) | (words[1] & mask.words[1]) |
+            (words[2] & mask.words[2]) | (words[3] & mask.words[3])) != 0;
+  }
+
+  //!
+  //! @brief true if no feature is present
+  //!
+  constexpr bool empty() const
+  {
+    return (words[0] | words[1] | words[2] | words[3]) == 0;
+  }
+
+  //!
+  //! @brief number of present features
+  //!
+  int count() const
+  {
+    int n = 0;
+    for (int i = 0; i < FEATURE_WORDS; ++i)
+      for (uint64_t w = words[i]; w != 0; w &= w - 1)
+        ++n;
+    return n;
+  }
+
+  //!
+  //! @brief add (or remove) a feature
+  //!
+  constexpr void set(Feature f, bool on = true)
+  {
+    if (on)
+      words[index(f) >> 6] |= (1ULL << (index(f) & 63));
+    else
+      words[index(f) >> 6] &= ~(1ULL << (index(f) & 63));
+  }
+
+  //!
+  //! @brief remove a feature
+  //!
+  constexpr void reset(Feature f) { set(f, false); }
+
+  constexpr FeatureSet &operator&=(const FeatureSet &rhs)
+  {
+    for (int i = 0; i < FEATURE_WORDS; ++i)
+      words[i] &= rhs.words[i];
+    return *this;
+  }
+
+  constexpr FeatureSet &operator|=(const FeatureSet &rhs)
+  {
+    for (int i = 0; i < FEATURE_WORDS; ++i)
+      words[i] |= rhs.words[i];
+    return *this;
+  }
+
+  //! @brief difference (features of this set that are not in rhs)
+  constexpr FeatureSet &operator-=(const FeatureSet &rhs)
+  {
+    for (int i = 0; i < FEATURE_WORDS; ++i)
+      words[i] &= ~rhs.words[i];
+    return *this;
+  }
+
+  constexpr bool operator==(const FeatureSet &rhs) const
+  {
+    return ((words[0] ^ rhs.words[0]) | (words[1] ^ rhs.words[1]) |
+            (words[2] ^ rhs.words[2]) | (words[3] ^ rhs.words[3])) == 0;
+  }
+
+  constexpr bool operator!=(const FeatureSet &rhs) const
+  {
+    return !(*this == rhs);
+  }
+
+private:
+  static constexpr int index(Feature f) { return static_cast<int>(f); }
+};
+
+static_assert(static_cast<int>(Feature::count) <=
+                FeatureSet::FEATURE_WORDS * 64,
+              "FeatureSet is too small for Feature");
+
+//! @brief intersection
+constexpr FeatureSet operator&(const FeatureSet &lhs, const FeatureSet &rhs)
+{
+  FeatureSet result = lhs;
+  return result &= rhs;
+}
+
+//! @brief union
+constexpr FeatureSet operator|(const FeatureSet &lhs, const FeatureSet &rhs)
+{
+  FeatureSet result = lhs;
+  return result |= rhs;
+}
+
+//! @brief difference
+constexpr FeatureSet operator-(const FeatureSet &lhs, const FeatureSet &rhs)
+{
+  FeatureSet result = lhs;
+  return result -= rhs;
+}
+
+//! @brief XCR0 SSE and AVX state
+static constexpr uint64_t XCR0_AVX = 0x06;
+
+//! @brief XCR0 opmask, ZMM_Hi256 and Hi16_ZMM state
+static constexpr uint64_t XCR0_AVX512 = 0xe0;
+
+//!
+//! @brief features that need the AVX state (XCR0_AVX) enabled
+//!
+static constexpr FeatureSet AVX_STATE_FEATURES = {
+  Feature::avx,  Feature::avx2, Feature::fma,       Feature::f16c,
+  Feature::vaes, Feature::vpclmulqdq
+};
+
+//!
+//! @brief features that need the AVX and AVX-512 state (XCR0_AVX512) enabled
+//!
+static constexpr FeatureSet AVX512_STATE_FEATURES = {
+  Feature::avx512f,         Feature::avx512dq,    Feature::avx512ifma,
+  Feature::avx512pf,        Feature::avx512er,    Feature::avx512cd,
+  Feature::avx512bw,        Feature::avx512vl,    Feature::avx512vbmi,
+  Feature::avx512vbmi2,     Feature::avx512vnni,  Feature::avx512bitalg,
+  Feature::avx512vpopcntdq, Feature::avx512vnniw, Feature::avx512fmaps,
+  Feature::avx512Vp2intersect
+};
+
+//!
+//! @brief features that can actually be executed
+//!
+//! CPUID reports what the processor implements; the AVX and AVX-512
+//! instructions also need the OS to save their registers (XCR0), otherwise
+//! they raise #UD.
+//!
+//! @param[in]    features  features reported by CPUID
+//! @param[in]    xcr0      XCR0 (0 if OSXSAVE is not set)
+//!
+constexpr FeatureSet usable_features(const FeatureSet &features, uint64_t xcr0)
+{
+  FeatureSet result = features;
+
+  if ((xcr0 & XCR0_AVX) != XCR0_AVX)
+    result -= AVX_STATE_FEATURES;
+  if ((xcr0 & (XCR0_AVX | XCR0_AVX512)) != (XCR0_AVX | XCR0_AVX512))
+    result -= AVX512_STATE_FEATURES;
+  return result;
+}
+
+//!
+//! @brief features guaranteed by the compilation target
+//!
+//! Derived from the predefined target macros (-mavx2, -march=..., /arch:AVX2,
+//! ...). Code built for such a target already requires these features, so
+//! run time checks of them can be folded away (see libcpu::has<>()).
+//!
+constexpr FeatureSet compiled_features()
+{
+  FeatureSet s;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  // x86-64 baseline
+  s.set(Feature::fpu);
+  s.set(Feature::tsc);
+  s.set(Feature::cx8);
+  s.set(Feature::cmov);
+  s.set(Feature::mmx);
+  s.set(Feature::fxsr);
+  s.set(Feature::sse);
+  s.set(Feature::sse2);
+  s.set(Feature::sysCallSysRet);
+#endif
+#if defined(_M_IX86_FP) && (_M_IX86_FP >= 1)
+  s.set(Feature::sse);
+#endif
+#if defined(_M_IX86_FP) && (_M_IX86_FP >= 2)
+  s.set(Feature::sse2);
+#endif
+#if defined(__SSE3__)
+  s.set(Feature::sse3);
+#endif
+#if defined(__PCLMUL__)
+  s.set(Feature::pclmulqdq);
+#endif
+#if defined(__SSSE3__)
+  s.set(Feature::ssse3);
+#endif
+#if defined(__FMA__)
+  s.set(Feature::fma);
+#endif
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  s.set(Feature::cx16);
+#endif
+#if defined(__SSE4_1__)
+  s.set(Feature::sse41);
+#endif
+#if defined(__SSE4_2__)
+  s.set(Feature::sse42);
+#endif
+#if defined(__MOVBE__)
+  s.set(Feature::movebe);
+#endif
+#if defined(__POPCNT__)
+  s.set(Feature::popcnt);
+#endif
+#if defined(__AES__)
+  s.set(Feature::ase);
+#endif
+#if defined(__XSAVE__)
+  s.set(Feature::xsave);
+#endif
+#if defined(__AVX__)
+  s.set(Feature::avx);
+#endif
+#if defined(__F16C__)
+  s.set(Feature::f16c);
+#endif
+#if defined(__RDRND__)
+  s.set(Feature::rdrnd);
+#endif
+#if defined(__MMX__)
+  s.set(Feature::mmx);
+#endif
+#if defined(__FXSR__)
+  s.set(Feature::fxsr);
+#endif
+#if defined(__SSE__)
+  s.set(Feature::sse);
+#endif
+#if defined(__SSE2__)
+  s.set(Feature::sse2);
+#endif
+#if defined(__FSGSBASE__)
+  s.set(Feature::fsgsbase);
+#endif
+#if defined(__BMI__)
+  s.set(Feature::bmi1);
+#endif
+#if defined(__HLE__)
+  s.set(Feature::hle);
+#endif
+#if defined(__AVX2__)
+  s.set(Feature::avx2);
+#endif
+#if defined(__BMI2__)
+  s.set(Feature::bmi2);
+#endif
+#if defined(__RTM__)
+  s.set(Feature::rtm);
+#endif
+#if defined(__AVX512F__)
+  s.set(Feature::avx512f);
+#endif
+#if defined(__AVX512DQ__)
+  s.set(Feature::avx512dq);
+#endif
+#if defined(__RDSEED__)
+  s.set(Feature::rdseed);
+#endif
+#if defined(__ADX__)
+  s.set(Feature::adx);
+#endif
+#if defined(__AVX512IFMA__)
+  s.set(Feature::avx512ifma);
+#endif
+#if defined(__CLFLUSHOPT__)
+  s.set(Feature::clflushopt);
+#endif
+#if defined(__CLWB__)
+  s.set(Feature::clwb);
+#endif
+#if defined(__AVX512PF__)
+  s.set(Feature::avx512pf);
+#endif
+#if defined(__AVX512ER__)
+  s.set(Feature::avx512er);
+#endif
+#if defined(__AVX512CD__)
+  s.set(Feature::avx512cd);
+#endif
+#if defined(__SHA__)
+  s.set(Feature::sha);
+#endif
+#if defined(__AVX512BW__)
+  s.set(Feature::avx512bw);
+#endif
+#if defined(__AVX512VL__)
+  s.set(Feature::avx512vl);
+#endif
+#if defined(__PREFETCHWT1__)
+  s.set(Feature::prefetchwt1);
+#endif
+#if defined(__AVX512VBMI__)
+  s.set(Feature::avx512vbmi);
+#endif
+#if defined(__PKU__)
+  s.set(Feature::pku);
+#endif
+#if defined(__WAITPKG__)
+  s.set(Feature::waitPkg);
+#endif
+#if defined(__AVX512VBMI2__)
+  s.set(Feature::avx512vbmi2);
+#endif
+#if defined(__GFNI__)
+  s.set(Feature::gfni);
+#endif
+#if defined(__VAES__)
+  s.set(Feature::vaes);
+#endif
+#if defined(__VPCLMULQDQ__)
+  s.set(Feature::vpclmulqdq);
+#endif
+#if defined(__AVX512VNNI__)
+  s.set(Feature::avx512vnni);
+#endif
+#if defined(__AVX512BITALG__)
+  s.set(Feature::avx512bitalg);
+#endif
+#if defined(__AVX512VPOPCNTDQ__)
+  s.set(Feature::avx512vpopcntdq);
+#endif
+#if defined(__RDPID__)
+  s.set(Feature::rdpid);
+#endif
+#if defined(__CLDEMOTE__)
+  s.set(Feature::cldemote);
+#endif
+#if defined(__MOVDIRI__)
+  s.set(Feature::movdiri);
+#endif
+#if defined(__MOVDIR64B__)
+  s.set(Feature::movdir64b);
+#endif
+#if defined(__ENQCMD__)
+  s.set(Feature::enqcmd);
+#endif
+#if defined(__AVX5124VNNIW__)
+  s.set(Feature::avx512vnniw);
+#endif
+#if defined(__AVX5124FMAPS__)
+  s.set(Feature::avx512fmaps);
+#endif
+#if defined(__AVX512VP2INTERSECT__)
+  s.set(Feature::avx512Vp2intersect);
+#endif
+#if defined(__PCONFIG__)
+  s.set(Feature::pconfig);
+#endif
+#if defined(__LZCNT__)
+  s.set(Feature::lzcnt);
+#endif
+#if defined(__SSE4A__)
+  s.set(Feature::sse4a);
+#endif
+#if defined(__PRFCHW__)
+  s.set(Feature::prefetch3DNow);
+#endif
+#if defined(__3dNOW_A__)
+  s.set(Feature::amd3DNowExt);
+#endif
+#if defined(__3dNOW__)
+  s.set(Feature::amd3DNow);
+#endif
+
+  return s;
+}
+
+//!
+//! @brief true if the compilation target guarantees the feature
+//!
+constexpr bool feature_compiled(Feature f)
+{
+  return compiled_features().has(f);
+}
+
+//!
+//! @brief feature name (same spelling as the Cpu member)
+//!
+//! @return name, or "unknown" for an out of range value
+//!
+const char *feature_name(Feature f);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_FEATURE_H
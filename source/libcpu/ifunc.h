@@ -0,0 +1,480 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_IFUNC_H
+#define LIB_CPU_IFUNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#include "feature.h"
+
+//
+// Freestanding detection core
+//
+// Everything in this header is a static inline function or a constant: no
+// heap, no libc call, no exception, no static local guard and no call through
+// the PLT. It can run in a GNU IFUNC resolver, which the dynamic linker calls
+// while it is still relocating the process, and in constructors that run
+// before main() or before the allocator is usable.
+//
+
+namespace libcpu {
+
+//!
+//! @brief CPUID registers read by the freestanding core
+//!
+enum BareRegister
+{
+  BARE_01_ECX,
+  BARE_01_EDX,
+  BARE_07_EBX,
+  BARE_07_ECX,
+  BARE_07_EDX,
+  BARE_80000001_ECX,
+  BARE_80000001_EDX,
+  BARE_REGISTERS
+};
+
+//!
+//! @brief Location of a feature flag
+//!
+struct BareFeatureBit
+{
+  Feature feature;
+  int reg;
+  uint32_t mask;
+};
+
+//!
+//! @brief feature flags of leaves 01H, 07H and 80000001H, with the same
+//!        meaning as the matching Cpu fields
+//!
+static constexpr BareFeatureBit BARE_FEATURE_BITS[] = {
+  // 01H ECX
+  { Feature::sse3, BARE_01_ECX, 0x00000001 },
+  { Feature::pclmulqdq, BARE_01_ECX, 0x00000002 },
+  { Feature::dtes64, BARE_01_ECX, 0x00000004 },
+  { Feature::monitor, BARE_01_ECX, 0x00000008 },
+  { Feature::dscpl, BARE_01_ECX, 0x00000010 },
+  { Feature::vmx, BARE_01_ECX, 0x00000020 },
+  { Feature::smx, BARE_01_ECX, 0x00000040 },
+  { Feature::est, BARE_01_ECX, 0x00000080 },
+  { Feature::tm2, BARE_01_ECX, 0x00000100 },
+  { Feature::ssse3, BARE_01_ECX, 0x00000200 },
+  { Feature::cnxtid, BARE_01_ECX, 0x00000400 },
+  { Feature::sdbg, BARE_01_ECX, 0x00000800 },
+  { Feature::fma, BARE_01_ECX, 0x00001000 },
+  { Feature::cx16, BARE_01_ECX, 0x00002000 },
+  { Feature::xtpr, BARE_01_ECX, 0x00004000 },
+  { Feature::pdcm, BARE_01_ECX, 0x00008000 },
+  { Feature::pcid, BARE_01_ECX, 0x00010000 },
+  { Feature::dca, BARE_01_ECX, 0x00040000 },
+  { Feature::sse41, BARE_01_ECX, 0x00080000 },
+  { Feature::sse42, BARE_01_ECX, 0x00100000 },
+  { Feature::x2apic, BARE_01_ECX, 0x00200000 },
+  { Feature::movebe, BARE_01_ECX, 0x00400000 },
+  { Feature::popcnt, BARE_01_ECX, 0x00800000 },
+  { Feature::tscDeadline, BARE_01_ECX, 0x01000000 },
+  { Feature::ase, BARE_01_ECX, 0x02000000 },
+  { Feature::xsave, BARE_01_ECX, 0x04000000 },
+  { Feature::osxsave, BARE_01_ECX, 0x08000000 },
+  { Feature::avx, BARE_01_ECX, 0x10000000 },
+  { Feature::f16c, BARE_01_ECX, 0x20000000 },
+  { Feature::rdrnd, BARE_01_ECX, 0x40000000 },
+  { Feature::hypervisor, BARE_01_ECX, 0x80000000 },
+  // 01H EDX
+  { Feature::fpu, BARE_01_EDX, 0x00000001 },
+  { Feature::mve, BARE_01_EDX, 0x00000002 },
+  { Feature::de, BARE_01_EDX, 0x00000004 },
+  { Feature::pse, BARE_01_EDX, 0x00000008 },
+  { Feature::tsc, BARE_01_EDX, 0x00000010 },
+  { Feature::msr, BARE_01_EDX, 0x00000020 },
+  { Feature::pae, BARE_01_EDX, 0x00000040 },
+  { Feature::mce, BARE_01_EDX, 0x00000080 },
+  { Feature::cx8, BARE_01_EDX, 0x00000100 },
+  { Feature::apic, BARE_01_EDX, 0x00000200 },
+  { Feature::sep, BARE_01_EDX, 0x00000800 },
+  { Feature::mttr, BARE_01_EDX, 0x00001000 },
+  { Feature::pge, BARE_01_EDX, 0x00002000 },
+  { Feature::mca, BARE_01_EDX, 0x00004000 },
+  { Feature::cmov, BARE_01_EDX, 0x00008000 },
+  { Feature::pat, BARE_01_EDX, 0x00010000 },
+  { Feature::pse36, BARE_01_EDX, 0x00020000 },
+  { Feature::psn, BARE_01_EDX, 0x00040000 },
+  { Feature::clfsh, BARE_01_EDX, 0x00080000 },
+  { Feature::ds, BARE_01_EDX, 0x00200000 },
+  { Feature::acpi, BARE_01_EDX, 0x00400000 },
+  { Feature::mmx, BARE_01_EDX, 0x00800000 },
+  { Feature::fxsr, BARE_01_EDX, 0x01000000 },
+  { Feature::sse, BARE_01_EDX, 0x02000000 },
+  { Feature::sse2, BARE_01_EDX, 0x04000000 },
+  { Feature::ss, BARE_01_EDX, 0x08000000 },
+  { Feature::htt, BARE_01_EDX, 0x10000000 },
+  { Feature::tm, BARE_01_EDX, 0x20000000 },
+  { Feature::ia64, BARE_01_EDX, 0x40000000 },
+  { Feature::pbe, BARE_01_EDX, 0x80000000 },
+  // 07H EBX
+  { Feature::fsgsbase, BARE_07_EBX, 0x00000001 },
+  { Feature::ia32TscAdjustMsr, BARE_07_EBX, 0x00000002 },
+  { Feature::sgx, BARE_07_EBX, 0x00000004 },
+  { Feature::bmi1, BARE_07_EBX, 0x00000008 },
+  { Feature::hle, BARE_07_EBX, 0x00000010 },
+  { Feature::avx2, BARE_07_EBX, 0x00000020 },
+  { Feature::smep, BARE_07_EBX, 0x00000080 },
+  { Feature::bmi2, BARE_07_EBX, 0x00000100 },
+  { Feature::erms, BARE_07_EBX, 0x00000200 },
+  { Feature::invpcid, BARE_07_EBX, 0x00000400 },
+  { Feature::rtm, BARE_07_EBX, 0x00000800 },
+  { Feature::pqm, BARE_07_EBX, 0x00001000 },
+  { Feature::fpucsds, BARE_07_EBX, 0x00002000 },
+  { Feature::mpx, BARE_07_EBX, 0x00004000 },
+  { Feature::pqe, BARE_07_EBX, 0x00008000 },
+  { Feature::avx512f, BARE_07_EBX, 0x00010000 },
+  { Feature::avx512dq, BARE_07_EBX, 0x00020000 },
+  { Feature::rdseed, BARE_07_EBX, 0x00040000 },
+  { Feature::adx, BARE_07_EBX, 0x00080000 },
+  { Feature::smap, BARE_07_EBX, 0x00100000 },
+  { Feature::avx512ifma, BARE_07_EBX, 0x00200000 },
+  { Feature::clflushopt, BARE_07_EBX, 0x00800000 },
+  { Feature::clwb, BARE_07_EBX, 0x01000000 },
+  { Feature::pt, BARE_07_EBX, 0x02000000 },
+  { Feature::avx512pf, BARE_07_EBX, 0x04000000 },
+  { Feature::avx512er, BARE_07_EBX, 0x08000000 },
+  { Feature::avx512cd, BARE_07_EBX, 0x10000000 },
+  { Feature::sha, BARE_07_EBX, 0x20000000 },
+  { Feature::avx512bw, BARE_07_EBX, 0x40000000 },
+  { Feature::avx512vl, BARE_07_EBX, 0x80000000 },
+  // 07H ECX
+  { Feature::prefetchwt1, BARE_07_ECX, 0x00000001 },
+  { Feature::avx512vbmi, BARE_07_ECX, 0x00000002 },
+  { Feature::umip, BARE_07_ECX, 0x00000004 },
+  { Feature::pku, BARE_07_ECX, 0x00000008 },
+  { Feature::ospke, BARE_07_ECX, 0x00000010 },
+  { Feature::waitPkg, BARE_07_ECX, 0x00000020 },
+  { Feature::avx512vbmi2, BARE_07_ECX, 0x00000040 },
+  { Feature::gfni, BARE_07_ECX, 0x00000100 },
+  { Feature::vaes, BARE_07_ECX, 0x00000200 },
+  { Feature::vpclmulqdq, BARE_07_ECX, 0x00000400 },
+  { Feature::avx512vnni, BARE_07_ECX, 0x00000800 },
+  { Feature::avx512bitalg, BARE_07_ECX, 0x00001000 },
+  { Feature::avx512vpopcntdq, BARE_07_ECX, 0x00004000 },
+  { Feature::rdpid, BARE_07_ECX, 0x00400000 },
+  { Feature::cldemote, BARE_07_ECX, 0x02000000 },
+  { Feature::movdiri, BARE_07_ECX, 0x08000000 },
+  { Feature::movdir64b, BARE_07_ECX, 0x10000000 },
+  { Feature::enqcmd, BARE_07_ECX, 0x20000000 },
+  { Feature::sgxlc, BARE_07_ECX, 0x40000000 },
+  // 07H EDX
+  { Feature::avx512vnniw, BARE_07_EDX, 0x00000004 },
+  { Feature::avx512fmaps, BARE_07_EDX, 0x00000008 },
+  { Feature::repmov, BARE_07_EDX, 0x00000010 },
+  { Feature::avx512Vp2intersect, BARE_07_EDX, 0x00000100 },
+  { Feature::serialize, BARE_07_EDX, 0x00004000 },
+  { Feature::hybrid, BARE_07_EDX, 0x00008000 },
+  { Feature::pconfig, BARE_07_EDX, 0x00040000 },
+  { Feature::emuIbrs, BARE_07_EDX, 0x04000000 },
+  { Feature::emuStibp, BARE_07_EDX, 0x08000000 },
+  { Feature::emuIa32ArchCapabilitiesMsr, BARE_07_EDX, 0x20000000 },
+  { Feature::emuIa32CoreCapabilitiesMsr, BARE_07_EDX, 0x40000000 },
+  { Feature::emuSsbd, BARE_07_EDX, 0x80000000 },
+  // 80000001H ECX
+  { Feature::ahf64, BARE_80000001_ECX, 0x00000001 },
+  { Feature::cmpLegacy, BARE_80000001_ECX, 0x00000002 },
+  { Feature::svm, BARE_80000001_ECX, 0x00000004 },
+  { Feature::extApicSpace, BARE_80000001_ECX, 0x00000008 },
+  { Feature::altMovCr8, BARE_80000001_ECX, 0x00000010 },
+  { Feature::lzcnt, BARE_80000001_ECX, 0x00000020 },
+  { Feature::sse4a, BARE_80000001_ECX, 0x00000040 },
+  { Feature::misalignedSse, BARE_80000001_ECX, 0x00000080 },
+  { Feature::prefetch3DNow, BARE_80000001_ECX, 0x00000100 },
+  { Feature::skinit, BARE_80000001_ECX, 0x00001000 },
+  { Feature::topoExt, BARE_80000001_ECX, 0x00400000 },
+  // 80000001H EDX
+  { Feature::sysCallSysRet, BARE_80000001_EDX, 0x00000800 },
+  { Feature::pat, BARE_80000001_EDX, 0x00010000 },
+  { Feature::amdMmx, BARE_80000001_EDX, 0x00040000 },
+  { Feature::amdFfxsr, BARE_80000001_EDX, 0x00200000 },
+  { Feature::amd1GBPage, BARE_80000001_EDX, 0x00400000 },
+  { Feature::rdtscp, BARE_80000001_EDX, 0x08000000 },
+  { Feature::amdLm, BARE_80000001_EDX, 0x20000000 },
+  { Feature::amd3DNowExt, BARE_80000001_EDX, 0x40000000 },
+  { Feature::amd3DNow, BARE_80000001_EDX, 0x80000000 }
+};
+
+//!
+//! @brief Result of the freestanding detection
+//!
+//! A trivial type: declaring one runs no constructor, so it can live in
+//! static storage that is used before constructors have run.
+//!
+struct BareCpu
+{
+  //! @brief vendor identification string
+  char vendor[16];
+
+  //! @brief maximum standard and extended leaves
+  uint32_t maxLeaf;
+  uint32_t maxExtLeaf;
+
+  //! @brief processor signature (leaf 01H EAX)
+  uint32_t signature;
+
+  //! @brief raw feature registers, indexed by BareRegister
+  uint32_t regs[BARE_REGISTERS];
+
+  //! @brief XCR0 (0 if OSXSAVE is not set)
+  uint64_t xcr0;
+
+  //! @brief FeatureSet words of the flags of leaves 01H, 07H and 80000001H
+  //!        (as in Cpu::features)
+  uint64_t features[FeatureSet::FEATURE_WORDS];
+
+  //! @brief features without those whose register state the OS disabled
+  uint64_t usable[FeatureSet::FEATURE_WORDS];
+};
+
+static_assert(std::is_trivial<BareCpu>::value,
+              "BareCpu must not need a constructor");
+
+
+//!
+//! @brief execute CPUID
+//!
+static inline void bare_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t r[4])
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; ++i)
+    r[i] = static_cast<uint32_t>(info[i]);
+#elif defined(__GNUC__)
+  __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+
+//!
+//! @brief execute XGETBV for XCR0
+//!
+static inline uint64_t bare_xgetbv()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#elif defined(__GNUC__)
+  uint32_t eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax | (static_cast<uint64_t>(edx) << 32);
+#endif
+}
+
+
+//!
+//! @brief remove a feature set from feature words
+//!
+static inline void bare_clear(uint64_t words[FeatureSet::FEATURE_WORDS],
+                              const FeatureSet &mask)
+{
+  for (int i = 0; i < FeatureSet::FEATURE_WORDS; ++i)
+    words[i] &= ~mask.words[i];
+}
+
+
+//!
+//! @brief every feature of required is in the available words
+//!
+static inline bool
+bare_has_all(const uint64_t available[FeatureSet::FEATURE_WORDS],
+             const FeatureSet &required)
+{
+  uint64_t missing = 0;
+
+  for (int i = 0; i < FeatureSet::FEATURE_WORDS; ++i)
+    missing |= required.words[i] & ~available[i];
+  return missing == 0;
+}
+
+
+//!
+//! @brief feature words as a FeatureSet (for use after the resolver phase)
+//!
+static inline FeatureSet
+bare_feature_set(const uint64_t words[FeatureSet::FEATURE_WORDS])
+{
+  FeatureSet set;
+
+  for (int i = 0; i < FeatureSet::FEATURE_WORDS; ++i)
+    set.words[i] = words[i];
+  return set;
+}
+
+
+//!
+//! @brief detect the features of the calling processor (at most 5 CPUIDs)
+//!
+//! @param[out]   cpu       detection result
+//!
+static inline void detect_bare_cpu(BareCpu *cpu)
+{
+  uint32_t r[4];
+
+  bare_cpuid(0x00000000, 0, r);
+  cpu->maxLeaf = r[0];
+  for (int i = 0; i < 4; ++i)
+  {
+    cpu->vendor[i]     = static_cast<char>(r[1] >> (8 * i));
+    cpu->vendor[4 + i] = static_cast<char>(r[3] >> (8 * i));
+    cpu->vendor[8 + i] = static_cast<char>(r[2] >> (8 * i));
+    cpu->vendor[12 + i] = '\0';
+  }
+
+  cpu->signature = 0;
+  for (int i = 0; i < BARE_REGISTERS; ++i)
+    cpu->regs[i] = 0;
+
+  if (cpu->maxLeaf >= 0x00000001)
+  {
+    bare_cpuid(0x00000001, 0, r);
+    cpu->signature          = r[0];
+    cpu->regs[BARE_01_ECX] = r[2];
+    cpu->regs[BARE_01_EDX] = r[3];
+  }
+
+  if (cpu->maxLeaf >= 0x00000007)
+  {
+    bare_cpuid(0x00000007, 0, r);
+    cpu->regs[BARE_07_EBX] = r[1];
+    cpu->regs[BARE_07_ECX] = r[2];
+    cpu->regs[BARE_07_EDX] = r[3];
+  }
+
+  bare_cpuid(0x80000000, 0, r);
+  cpu->maxExtLeaf = ((r[0] & 0xffff0000) == 0x80000000) ? r[0] : 0;
+  if (cpu->maxExtLeaf >= 0x80000001)
+  {
+    bare_cpuid(0x80000001, 0, r);
+    cpu->regs[BARE_80000001_ECX] = r[2];
+    cpu->regs[BARE_80000001_EDX] = r[3];
+  }
+
+  // XGETBV is only available when the OS has set CR4.OSXSAVE
+  cpu->xcr0 = (cpu->regs[BARE_01_ECX] & 0x08000000) ? bare_xgetbv() : 0;
+
+  for (int i = 0; i < FeatureSet::FEATURE_WORDS; ++i)
+    cpu->features[i] = 0;
+  for (const BareFeatureBit &b : BARE_FEATURE_BITS)
+  {
+    int f = static_cast<int>(b.feature);
+    if (cpu->regs[b.reg] & b.mask)
+      cpu->features[f / 64] |= static_cast<uint64_t>(1) << (f % 64);
+  }
+
+  for (int i = 0; i < FeatureSet::FEATURE_WORDS; ++i)
+    cpu->usable[i] = cpu->features[i];
+  if ((cpu->xcr0 & XCR0_AVX) != XCR0_AVX)
+    bare_clear(cpu->usable, AVX_STATE_FEATURES);
+  if ((cpu->xcr0 & (XCR0_AVX | XCR0_AVX512)) != (XCR0_AVX | XCR0_AVX512))
+    bare_clear(cpu->usable, AVX512_STATE_FEATURES);
+}
+
+
+//!
+//! @brief One implementation offered to select_ifunc()
+//!
+template <typename Fn>
+struct IfuncCandidate
+{
+  //! @brief implementation (preferably with internal linkage)
+  Fn fn;
+
+  //! @brief features the implementation requires
+  FeatureSet required;
+};
+
+
+//!
+//! @brief pick the first candidate whose features are usable
+//!
+//! @param[in]    candidates  in order of preference; the last one is returned
+//!                           when none is supported
+//!
+//! @return selected implementation
+//!
+template <typename Fn, size_t N>
+static inline Fn select_ifunc(const IfuncCandidate<Fn> (&candidates)[N])
+{
+  BareCpu cpu;
+
+  detect_bare_cpu(&cpu);
+  for (size_t i = 0; i < N; ++i)
+    if (bare_has_all(cpu.usable, candidates[i].required))
+      return candidates[i].fn;
+  return candidates[N - 1].fn;
+}
+
+} // namespace libcpu
+
+
+#if defined(__GNUC__) && defined(__ELF__)
+
+//! @brief GNU indirect functions are available
+#define LIBCPU_HAS_IFUNC 1
+
+//!
+//! @brief declare an indirect function and open the body of its resolver
+//!
+//! The dynamic linker calls the resolver once, at load time, and binds every
+//! call of name directly to the returned implementation.
+//!
+//! @code
+//!   static constexpr libcpu::FeatureSet AVX2 = { libcpu::Feature::avx2 };
+//!
+//!   LIBCPU_IFUNC_RESOLVER(int, sum, (const int *values, int count))
+//!   {
+//!     libcpu::BareCpu cpu;
+//!     libcpu::detect_bare_cpu(&cpu);
+//!     return libcpu::bare_has_all(cpu.usable, AVX2) ? sum_avx2 : sum_c;
+//!   }
+//! @endcode
+//!
+#define LIBCPU_IFUNC_RESOLVER(ret, name, params)                              \
+  extern "C" ret (*libcpu_resolve_##name()) params;                           \
+  ret name params __attribute__((ifunc("libcpu_resolve_" #name)));            \
+  extern "C" ret (*libcpu_resolve_##name()) params
+
+//!
+//! @brief define an indirect function from a candidate list
+//!
+//! @code
+//!   LIBCPU_IFUNC(int, sum, (const int *values, int count),
+//!                { sum_avx2, { libcpu::Feature::avx2 } },
+//!                { sum_sse2, { libcpu::Feature::sse2 } },
+//!                { sum_c, {} })
+//! @endcode
+//!
+#define LIBCPU_IFUNC(ret, name, params, ...)                                  \
+  LIBCPU_IFUNC_RESOLVER(ret, name, params)                                    \
+  {                                                                           \
+    static constexpr libcpu::IfuncCandidate<ret (*) params> candidates[] = {  \
+      __VA_ARGS__                                                             \
+    };                                                                        \
+    return libcpu::select_ifunc(candidates);                                  \
+  }
+
+#else
+
+//! @brief GNU indirect functions are not available (use Dispatcher)
+#define LIBCPU_HAS_IFUNC 0
+
+#endif
+
+#endif // LIB_CPU_IFUNC_H
@@ -0,0 +1,67 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include "cpu.h"
+
+using namespace libcpu;
+
+//! @brief x86-64 baseline (LM, CMOV, CX8, FPU, FXSR, MMX, SCE, SSE, SSE2)
+static constexpr FeatureSet LEVEL1 = {
+  Feature::amdLm, Feature::cmov, Feature::cx8,           Feature::fpu,
+  Feature::fxsr,  Feature::mmx,  Feature::sysCallSysRet, Feature::sse,
+  Feature::sse2
+};
+
+//! @brief x86-64-v2 (CMPXCHG16B, LAHF-SAHF, POPCNT, SSE3, SSE4.1, SSE4.2,
+//!        SSSE3)
+static constexpr FeatureSet LEVEL2 = {
+  Feature::cx16,  Feature::ahf64, Feature::popcnt, Feature::sse3,
+  Feature::sse41, Feature::sse42, Feature::ssse3
+};
+
+//! @brief x86-64-v3 (AVX, AVX2, BMI1, BMI2, F16C, FMA, LZCNT, MOVBE, OSXSAVE)
+static constexpr FeatureSet LEVEL3 = {
+  Feature::avx,  Feature::avx2, Feature::bmi1,  Feature::bmi2,
+  Feature::f16c, Feature::fma,  Feature::lzcnt, Feature::movebe,
+  Feature::osxsave
+};
+
+//! @brief x86-64-v4 (AVX512F, AVX512BW, AVX512CD, AVX512DQ, AVX512VL)
+static constexpr FeatureSet LEVEL4 = {
+  Feature::avx512f, Feature::avx512bw, Feature::avx512cd, Feature::avx512dq,
+  Feature::avx512vl
+};
+
+
+int libcpu::isa_level(const Cpu &cpu)
+{
+  const FeatureSet &f = cpu.features;
+
+  if (!f.has_all(LEVEL1))
+    return 0;
+  if (!f.has_all(LEVEL2))
+    return 1;
+  if (!f.has_all(LEVEL3) || ((cpu.xcr0 & XCR0_AVX) != XCR0_AVX))
+    return 2;
+  if (!f.has_all(LEVEL4) || ((cpu.xcr0 & XCR0_AVX512) != XCR0_AVX512))
+    return 3;
+  return 4;
+}
+
+
+int libcpu::isa_level()
+{
+  return isa_level(current());
+}
+
+
+const char *libcpu::isa_level_name(int level)
+{
+  static const char *const names[] = { "none", "x86-64", "x86-64-v2",
+                                       "x86-64-v3", "x86-64-v4" };
+
+  if ((level < 0) || (level > 4))
+    return "unknown";
+  return names[level];
+}
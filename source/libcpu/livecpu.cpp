@@ -0,0 +1,325 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "affinity.h"
+#include "livecpu.h"
+#include "topology.h"
+#include "tsc.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace libcpu;
+
+static_assert(is_trivially_copyable<LiveCpuData>::value,
+              "LiveCpuData is copied by readers as is");
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "the seqlock must be address free to be shared");
+
+
+bool libcpu::read_live_cpu_info(const LiveCpuShared &shared,
+                                LiveCpuData *data)
+{
+  uint32_t before, after;
+
+  do
+  {
+    before = shared.sequence.load(memory_order_acquire);
+    if (before & 1)
+      continue;
+    memcpy(data, &shared.data, sizeof(LiveCpuData));
+    atomic_thread_fence(memory_order_acquire);
+    after = shared.sequence.load(memory_order_relaxed);
+  } while ((before & 1) || (before != after));
+
+  return data->generation != 0;
+}
+
+
+#if defined(__linux__)
+
+//!
+//! @brief parse a sysfs cpu list such as "0-3,8,10-11"
+//!
+static vector<int> parse_cpu_list(const char *path)
+{
+  vector<int> cpus;
+  char buffer[4096] = "";
+  FILE *fp = fopen(path, "r");
+
+  if (fp == nullptr)
+    return cpus;
+  if (fgets(buffer, sizeof(buffer), fp) == nullptr)
+    buffer[0] = '\0';
+  fclose(fp);
+
+  for (char *p = buffer; *p != '\0';)
+  {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p)
+      break;
+    long last = first;
+    if (*end == '-')
+      last = strtol(end + 1, &end, 10);
+    for (long i = first; i <= last; ++i)
+      cpus.push_back(static_cast<int>(i));
+    p = (*end == ',') ? end + 1 : end;
+  }
+
+  return cpus;
+}
+
+
+//!
+//! @brief current cpufreq frequency of a processor (in kHz, 0 if unknown)
+//!
+static uint32_t read_frequency(int cpu)
+{
+  char path[96];
+  unsigned long khz = 0;
+
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+  FILE *fp = fopen(path, "r");
+  if (fp == nullptr)
+    return 0;
+  if (fscanf(fp, "%lu", &khz) != 1)
+    khz = 0;
+  fclose(fp);
+
+  return static_cast<uint32_t>(khz);
+}
+
+
+bool libcpu::collect_live_cpu_info(LiveCpuData *data)
+{
+  const Cpu &cpu = current();
+  Topology topology;
+
+  // processors brought online after start are not in the inherited mask
+  vector<int> online = parse_cpu_list("/sys/devices/system/cpu/online");
+  if (!online.empty())
+    set_thread_affinity(online);
+
+  *data = LiveCpuData();
+  if (!detect_topology(cpu, &topology))
+    return false;
+
+  data->features     = cpu.features;
+  data->tscFrequency = tsc_clock::frequency();
+  memcpy(data->vendor, cpu.vendor, sizeof(data->vendor));
+  memcpy(data->brand, cpu.brand, sizeof(data->brand));
+  data->packages = topology.packages;
+  data->dies     = topology.dies;
+  data->cores    = topology.cores;
+  data->threads  = topology.threads;
+
+  for (const LogicalCpu &c : topology.cpus)
+  {
+    if (data->count == LIVE_CPU_MAX)
+      break;
+    LiveLogicalCpu &l = data->cpus[data->count++];
+    l.index     = c.index;
+    l.x2apicId  = c.x2apicId;
+    l.package   = c.package;
+    l.die       = c.die;
+    l.core      = c.core;
+    l.thread    = c.thread;
+    l.frequency = read_frequency(c.index);
+  }
+
+  return true;
+}
+
+
+//!
+//! @brief write a payload under the seqlock
+//!
+static void publish(LiveCpuShared *shared, LiveCpuData *data)
+{
+  struct timespec ts;
+  uint32_t sequence = shared->sequence.load(memory_order_relaxed);
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  data->generation = shared->data.generation + 1;
+  data->updated    = static_cast<uint64_t>(ts.tv_sec) * 1000000000 +
+                  static_cast<uint64_t>(ts.tv_nsec);
+
+  shared->sequence.store(sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(&shared->data, data, sizeof(LiveCpuData));
+  shared->sequence.store(sequence + 2, memory_order_release);
+}
+
+
+//!
+//! @brief socket receiving kernel uevents (-1 if unavailable)
+//!
+static int open_uevent_socket()
+{
+  struct sockaddr_nl addr;
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                  NETLINK_KOBJECT_UEVENT);
+
+  if (fd < 0)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+
+//!
+//! @brief drain pending uevents
+//!
+//! @return true if one of them concerns a processor
+//!
+static bool cpu_uevent(int fd)
+{
+  char buffer[4096];
+  bool hotplug = false;
+  ssize_t n;
+
+  while ((n = recv(fd, buffer, sizeof(buffer) - 1, 0)) > 0)
+  {
+    buffer[n] = '\0';
+    if (strstr(buffer, "/devices/system/cpu/cpu") != nullptr)
+      hotplug = true;
+  }
+
+  return hotplug;
+}
+
+
+bool libcpu::serve_live_cpu_info(const char *name, int interval,
+                                 const atomic<bool> &stop)
+{
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, sizeof(LiveCpuShared)) != 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(nullptr, sizeof(LiveCpuShared), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  // an object left by a previous publisher keeps its sequence, so readers
+  // mapping it never see the counter go backwards
+  LiveCpuShared *shared = static_cast<LiveCpuShared *>(map);
+  if (shared->sequence.load() & 1)
+    shared->sequence.fetch_add(1);
+  shared->version = LIVE_CPU_VERSION;
+  shared->size    = sizeof(LiveCpuShared);
+
+  LiveCpuData *data = new LiveCpuData;
+  int uevent        = open_uevent_socket();
+
+  while (!stop.load())
+  {
+    if (collect_live_cpu_info(data))
+      publish(shared, data);
+
+    struct pollfd pfd;
+    pfd.fd     = uevent;
+    pfd.events = POLLIN;
+    for (int waited = 0; (waited < interval) && !stop.load(); waited += 100)
+    {
+      if (poll(&pfd, (uevent >= 0) ? 1 : 0, 100) > 0 && cpu_uevent(uevent))
+        break;
+    }
+  }
+
+  if (uevent >= 0)
+    close(uevent);
+  delete data;
+  munmap(map, sizeof(LiveCpuShared));
+  shm_unlink(name);
+  return true;
+}
+
+
+const LiveCpuShared *libcpu::map_live_cpu_info(const char *name)
+{
+  struct stat st;
+  int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+
+  if (fd < 0)
+    return nullptr;
+  // as with the snapshot cache, only root or the caller may publish
+  if ((fstat(fd, &st) != 0) || (st.st_size != sizeof(LiveCpuShared)) ||
+      ((st.st_uid != 0) && (st.st_uid != geteuid())))
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  void *map = mmap(nullptr, sizeof(LiveCpuShared), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return nullptr;
+
+  const LiveCpuShared *shared = static_cast<const LiveCpuShared *>(map);
+  if ((shared->version != LIVE_CPU_VERSION) ||
+      (shared->size != sizeof(LiveCpuShared)))
+  {
+    munmap(map, sizeof(LiveCpuShared));
+    return nullptr;
+  }
+
+  return shared;
+}
+
+#else
+
+bool libcpu::collect_live_cpu_info(LiveCpuData *data)
+{
+  *data = LiveCpuData();
+  return false;
+}
+
+
+bool libcpu::serve_live_cpu_info(const char *, int, const atomic<bool> &)
+{
+  return false;
+}
+
+
+const LiveCpuShared *libcpu::map_live_cpu_info(const char *)
+{
+  return nullptr;
+}
+
+#endif
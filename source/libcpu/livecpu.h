@@ -0,0 +1,165 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_LIVECPU_H
+#define LIB_CPU_LIVECPU_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief default POSIX shared memory object name
+//!
+static const char LIVE_CPU_SHM_NAME[] = "/libcpu";
+
+//!
+//! @brief layout version; bump whenever LiveCpuShared changes
+//!
+static const uint32_t LIVE_CPU_VERSION = 1;
+
+//!
+//! @brief maximum number of logical processors published
+//!
+static const int LIVE_CPU_MAX = 512;
+
+//!
+//! @brief One online logical processor
+//!
+struct LiveLogicalCpu
+{
+  //! @brief OS logical processor number
+  int32_t index;
+
+  //! @brief x2APIC ID
+  uint32_t x2apicId;
+
+  //! @brief dense package, die, core and SMT thread numbers (see LogicalCpu)
+  int32_t package;
+  int32_t die;
+  int32_t core;
+  int32_t thread;
+
+  //! @brief current frequency from cpufreq (in kHz, 0 if unknown)
+  uint32_t frequency;
+
+  uint32_t reserved;
+};
+
+//!
+//! @brief Payload of the live publication (plain data, copied by readers)
+//!
+struct LiveCpuData
+{
+  //! @brief number of publications so far (0: nothing published yet)
+  uint64_t generation;
+
+  //! @brief CLOCK_MONOTONIC time of the publication (in ns)
+  uint64_t updated;
+
+  //! @brief features of the publishing process's cpu
+  FeatureSet features;
+
+  //! @brief TSC frequency used by tsc_clock (in Hz)
+  uint64_t tscFrequency;
+
+  char vendor[32];
+  char brand[64];
+
+  //! @brief counts over the published processors
+  int32_t packages;
+  int32_t dies;
+  int32_t cores;
+  int32_t threads;
+
+  //! @brief entries of cpus[] in use
+  int32_t count;
+
+  uint32_t reserved;
+
+  //! @brief online processors in ascending index order
+  LiveLogicalCpu cpus[LIVE_CPU_MAX];
+};
+
+//!
+//! @brief Shared memory object: a seqlock and its payload
+//!
+struct LiveCpuShared
+{
+  //! @brief seqlock sequence; odd while the publisher is writing
+  std::atomic<uint32_t> sequence;
+
+  //! @brief LIVE_CPU_VERSION
+  uint32_t version;
+
+  //! @brief sizeof(LiveCpuShared)
+  uint32_t size;
+
+  uint32_t reserved;
+
+  //! @brief published data (read through read_live_cpu_info())
+  LiveCpuData data;
+};
+
+
+//!
+//! @brief gather the live data of this host
+//!
+//! Widens the calling thread's affinity to every online processor (so that
+//! hotplugged ones are included), runs detect_topology() and reads cpufreq
+//! from sysfs; intended for the publisher, not for readers.
+//!
+//! @param[out]   data      filled payload (generation and updated are 0)
+//!
+//! @return false if the topology could not be detected
+//!
+bool collect_live_cpu_info(LiveCpuData *data);
+
+
+//!
+//! @brief publish into shared memory and refresh until stopped
+//!
+//! Creates the object (mode 0644), publishes, then republishes on every CPU
+//! hotplug uevent and at least every interval. The object is removed when
+//! stop is set; readers that mapped it keep the last publication.
+//!
+//! @param[in]    name        shared memory object name
+//! @param[in]    interval    refresh period (in milliseconds)
+//! @param[in]    stop        polled between refreshes
+//!
+//! @return false if the object could not be created
+//!
+bool serve_live_cpu_info(const char *name, int interval,
+                         const std::atomic<bool> &stop);
+
+
+//!
+//! @brief map a published object read-only
+//!
+//! @param[in]    name      shared memory object name
+//!
+//! @return mapping valid until exit, nullptr if missing or incompatible
+//!
+const LiveCpuShared *map_live_cpu_info(const char *name = LIVE_CPU_SHM_NAME);
+
+
+//!
+//! @brief copy a consistent view of the published data
+//!
+//! Retries while the publisher is writing; no system call, no CPUID.
+//!
+//! @param[in]    shared    mapping from map_live_cpu_info()
+//! @param[out]   data      consistent copy
+//!
+//! @return false if nothing has been published yet
+//!
+bool read_live_cpu_info(const LiveCpuShared &shared, LiveCpuData *data);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_LIVECPU_H
@@ -0,0 +1,260 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+
+#include "affinity.h"
+#include "blocking.h"
+#include "memprobe.h"
+#include "placement.h"
+
+using namespace std;
+using namespace libcpu;
+
+//! @brief keeps the measured loops from being optimized away
+static atomic<uintptr_t> probeSink(0);
+
+//!
+//! @brief page aligned buffer of one probing thread
+//!
+class ProbeBuffer
+{
+public:
+  explicit ProbeBuffer(size_t bytes)
+    : storage(new (nothrow) char[bytes + PAGE]), size(bytes)
+  {
+    uintptr_t p = reinterpret_cast<uintptr_t>(storage.get());
+    data = reinterpret_cast<char *>((p + PAGE - 1) & ~(PAGE - 1));
+  }
+
+  bool valid() const { return storage != nullptr; }
+
+  char *get() const { return data; }
+
+  size_t bytes() const { return size; }
+
+private:
+  enum : uintptr_t { PAGE = 4096 };
+
+  unique_ptr<char[]> storage;
+  char *data = nullptr;
+  size_t size;
+};
+
+
+//!
+//! @brief seconds elapsed since a start point
+//!
+static double elapsed(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start)
+    .count();
+}
+
+
+//!
+//! @brief dependent load latency over the first bytes of a buffer (ns)
+//!
+static double measure_latency(const ProbeBuffer &buffer, size_t bytes,
+                              size_t lineSize, double minSeconds)
+{
+  size_t lines = max<size_t>(bytes / lineSize, 2);
+  vector<size_t> order(lines);
+  mt19937_64 random(lines);
+  char *base = buffer.get();
+  uint64_t loads = 0;
+  double seconds;
+
+  // Sattolo's algorithm: a single cycle through every line
+  for (size_t i = 0; i < lines; ++i)
+    order[i] = i;
+  for (size_t i = lines - 1; i > 0; --i)
+    swap(order[i], order[uniform_int_distribution<size_t>(0, i - 1)(random)]);
+  for (size_t i = 0; i < lines; ++i)
+    *reinterpret_cast<void **>(base + i * lineSize) = base + order[i] * lineSize;
+
+  void *p = base;
+  for (size_t i = 0; i < lines; ++i) // warm up
+    p = *static_cast<void **>(p);
+
+  auto start = chrono::steady_clock::now();
+  do
+  {
+    for (int i = 0; i < 4096; i += 8)
+    {
+      p = *static_cast<void **>(p); p = *static_cast<void **>(p);
+      p = *static_cast<void **>(p); p = *static_cast<void **>(p);
+      p = *static_cast<void **>(p); p = *static_cast<void **>(p);
+      p = *static_cast<void **>(p); p = *static_cast<void **>(p);
+    }
+    loads += 4096;
+  } while ((seconds = elapsed(start)) < minSeconds);
+
+  probeSink.fetch_add(reinterpret_cast<uintptr_t>(p), memory_order_relaxed);
+  return seconds * 1e9 / static_cast<double>(loads);
+}
+
+
+//!
+//! @brief sequential read bandwidth over the first bytes of a buffer (GB/s)
+//!
+static double measure_bandwidth(const ProbeBuffer &buffer, size_t bytes,
+                                double minSeconds)
+{
+  const uint64_t *data = reinterpret_cast<const uint64_t *>(buffer.get());
+  size_t words = max<size_t>(bytes / sizeof(uint64_t), 4) & ~size_t(3);
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  uint64_t total = 0;
+  double seconds;
+
+  auto start = chrono::steady_clock::now();
+  do
+  {
+    for (size_t i = 0; i < words; i += 4)
+    {
+      s0 += data[i + 0];
+      s1 += data[i + 1];
+      s2 += data[i + 2];
+      s3 += data[i + 3];
+    }
+    total += words * sizeof(uint64_t);
+  } while ((seconds = elapsed(start)) < minSeconds);
+
+  probeSink.fetch_add(static_cast<uintptr_t>(s0 + s1 + s2 + s3),
+                      memory_order_relaxed);
+  return static_cast<double>(total) / seconds / 1e9;
+}
+
+
+bool libcpu::probe_memory(const Cpu &cpu, const MemoryProbeOptions &options,
+                          MemoryProbe *probe)
+{
+  CacheBudget llc;
+  size_t lineSize = 64;
+  size_t maxBytes = options.maxBytes;
+  vector<size_t> sizes;
+  vector<int> plan;
+  int threads = options.threads;
+
+  probe->points.clear();
+  probe->boundaries.clear();
+
+  if (threads <= 0)
+    threads = max(static_cast<int>(online_cpus().size()), 1);
+
+  if (cache_budget(cpu, last_level_cache(cpu), &llc))
+    lineSize = max(llc.lineSize, sizeof(void *));
+  // threads sharing an instance overflow it together
+  if (maxBytes == 0)
+    maxBytes = max<size_t>(llc.size * 4, 64 * 1024 * 1024) /
+               min(max(llc.sharing, 1), threads);
+  if (options.maxTotalBytes != 0)
+    maxBytes = min(maxBytes, options.maxTotalBytes / threads);
+  maxBytes = max(maxBytes, max(options.minBytes, lineSize * 2));
+
+  // geometric steps, rounded to whole lines
+  double step = pow(2.0, 1.0 / max(options.stepsPerOctave, 1));
+  for (double b = static_cast<double>(max(options.minBytes, lineSize * 2));
+       b <= static_cast<double>(maxBytes) * 1.0001; b *= step)
+  {
+    size_t bytes = (static_cast<size_t>(b) / lineSize) * lineSize;
+    if (sizes.empty() || (bytes != sizes.back()))
+      sizes.push_back(bytes);
+  }
+
+  plan = plan_placement(threads, PlacementPolicy::spreadLlc);
+  probe->threads = threads;
+  probe->points.resize(sizes.size());
+  for (size_t i = 0; i < sizes.size(); ++i)
+    probe->points[i].bytes = sizes[i];
+
+  vector<double> latency(threads * sizes.size());
+  vector<double> bandwidth(threads * sizes.size());
+  atomic<int> failed(0);
+  atomic<int> arrived(0);
+  vector<thread> workers;
+
+  // every size is measured by all threads at once, separated by barriers
+  auto barrier = [&](int generation) {
+    arrived.fetch_add(1);
+    while (arrived.load() < threads * generation)
+      this_thread::yield();
+  };
+
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.emplace_back([&, t]() {
+      if (!plan.empty() && !pin_thread(plan[t]))
+        failed.fetch_add(1);
+
+      // allocated after pinning so that the pages are local to the thread
+      ProbeBuffer buffer(maxBytes);
+      if (!buffer.valid())
+        failed.fetch_add(1);
+      barrier(1);
+
+      for (size_t i = 0; i < sizes.size(); ++i)
+      {
+        if (failed.load() == 0)
+        {
+          latency[t * sizes.size() + i] =
+            measure_latency(buffer, sizes[i], lineSize, options.minSeconds);
+          bandwidth[t * sizes.size() + i] =
+            measure_bandwidth(buffer, sizes[i], options.minSeconds);
+        }
+        barrier(static_cast<int>(i) + 2);
+      }
+    });
+  }
+  for (thread &w : workers)
+    w.join();
+
+  if (failed.load() != 0)
+    return false;
+
+  for (size_t i = 0; i < sizes.size(); ++i)
+  {
+    for (int t = 0; t < threads; ++t)
+    {
+      probe->points[i].latency   += latency[t * sizes.size() + i] / threads;
+      probe->points[i].bandwidth += bandwidth[t * sizes.size() + i];
+    }
+  }
+  detect_cache_boundaries(probe);
+
+  return true;
+}
+
+
+void libcpu::detect_cache_boundaries(MemoryProbe *probe, double ratio)
+{
+  const vector<MemoryProbePoint> &points = probe->points;
+  bool rising = false;
+
+  probe->boundaries.clear();
+
+  // a step starts where latency jumps and lasts while it keeps climbing
+  for (size_t i = 0; i + 1 < points.size(); ++i)
+  {
+    double growth = points[i + 1].latency / max(points[i].latency, 1e-9);
+
+    if (!rising && (growth >= ratio))
+    {
+      probe->boundaries.push_back(points[i].bytes);
+      rising = true;
+    }
+    else if (rising && (growth < 1.0 + (ratio - 1.0) / 2))
+    {
+      rising = false;
+    }
+  }
+}
@@ -0,0 +1,104 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_MEMPROBE_H
+#define LIB_CPU_MEMPROBE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief Parameters of a memory probe
+//!
+struct MemoryProbeOptions
+{
+  //! @brief smallest working set per thread (bytes)
+  size_t minBytes = 4 * 1024;
+
+  //! @brief largest working set per thread (bytes, 0: four times the
+  //!        last-level cache, at least 64MB, split between the probing
+  //!        threads that share a last-level cache instance)
+  size_t maxBytes = 0;
+
+  //! @brief cap on the buffers of all threads together (bytes, 0: none);
+  //!        lowers maxBytes when threads * maxBytes would exceed it
+  size_t maxTotalBytes = static_cast<size_t>(1) << 30;
+
+  //! @brief working set sizes measured per doubling
+  int stepsPerOctave = 4;
+
+  //! @brief threads running the probe at the same time, each pinned to its
+  //!        own processor and walking its own buffer (0: every processor)
+  int threads = 1;
+
+  //! @brief minimum duration of one measurement (seconds)
+  double minSeconds = 0.02;
+};
+
+//!
+//! @brief Result of one working set size
+//!
+struct MemoryProbePoint
+{
+  //! @brief working set per thread (bytes)
+  size_t bytes = 0;
+
+  //! @brief dependent load latency averaged over the threads (ns)
+  double latency = 0.0;
+
+  //! @brief read bandwidth summed over the threads (GB/s)
+  double bandwidth = 0.0;
+};
+
+//!
+//! @brief Result of a memory probe
+//!
+struct MemoryProbe
+{
+  //! @brief threads that ran the probe
+  int threads = 0;
+
+  //! @brief measurements in ascending working set order
+  std::vector<MemoryProbePoint> points;
+
+  //! @brief effective cache capacities per thread: the last working set
+  //!        before each latency step, ascending
+  std::vector<size_t> boundaries;
+};
+
+
+//!
+//! @brief measure latency and bandwidth across working set sizes
+//!
+//! Latency is a pointer chase through a random cyclic permutation of cache
+//! lines, so hardware prefetchers cannot hide it; bandwidth is a sequential
+//! read with independent accumulators. Both include TLB effects.
+//!
+//! @param[in]    cpu       decoded cpu information (line and LLC size)
+//! @param[in]    options   probe parameters
+//! @param[out]   probe     result
+//!
+//! @return false if the threads could not be pinned or memory is exhausted
+//!
+bool probe_memory(const Cpu &cpu, const MemoryProbeOptions &options,
+                  MemoryProbe *probe);
+
+
+//!
+//! @brief find the latency steps of a probe
+//!
+//! @param[in,out]  probe   probe whose boundaries are recomputed
+//! @param[in]      ratio   latency increase between two neighbouring points
+//!                         that starts a step
+//!
+void detect_cache_boundaries(MemoryProbe *probe, double ratio = 1.25);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_MEMPROBE_H
@@ -0,0 +1,78 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <memory>
+#include <thread>
+
+#include "affinity.h"
+#include "cpu.h"
+#include "topology.h"
+
+using namespace std;
+using namespace libcpu;
+
+bool libcpu::detect_cpu_info_all(vector<Cpu> *cpus)
+{
+  vector<int> online = online_cpus();
+  vector<thread> workers;
+  unique_ptr<bool[]> ok;
+  bool result = true;
+
+  cpus->clear();
+
+  // no affinity interface: describe whatever processor the caller is on
+  if (online.empty())
+  {
+    cpus->resize(1);
+    detect_cpu_info(&cpus->front());
+    return false;
+  }
+
+  cpus->resize(online.size());
+  ok.reset(new bool[online.size()]);
+
+  // one worker per processor so that pinning and the CPUID round trips of
+  // different processors overlap; the caller's affinity is never touched
+  for (size_t i = 0; i < online.size(); ++i)
+  {
+    workers.emplace_back([&, i]() {
+      unique_ptr<CpuidSnapshot> snapshot(new CpuidSnapshot);
+      Cpu &cpu = (*cpus)[i];
+
+      ok[i] = capture_cpuid(online[i], snapshot.get());
+      if (ok[i])
+      {
+        detect_cpu_info(&cpu, *snapshot);
+        cpu.cpuIndex = online[i];
+      }
+    });
+  }
+  for (thread &t : workers)
+    t.join();
+
+  for (size_t i = 0; i < online.size(); ++i)
+    result = result && ok[i];
+
+  // sharing sets need every processor's x2APIC ID, so they are filled last
+  Topology topology;
+  topology.caches = cache_instances(*cpus);
+  for (Cpu &cpu : *cpus)
+    assign_cache_sharing(&cpu, topology);
+
+  return result;
+}
+
+
+vector<int> libcpu::cpus_of_core_type(const vector<Cpu> &cpus, int coreType)
+{
+  vector<int> result;
+
+  for (const Cpu &cpu : cpus)
+  {
+    if ((cpu.cpuIndex >= 0) && (cpu.coreType == coreType))
+      result.push_back(cpu.cpuIndex);
+  }
+
+  return result;
+}
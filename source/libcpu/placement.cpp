@@ -0,0 +1,277 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+
+#include "affinity.h"
+#include "placement.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief placement attributes of one logical processor
+//!
+struct Slot
+{
+  //! @brief OS logical processor number
+  int cpu = -1;
+
+  //! @brief last-level cache instance (shareShift << 32 | instanceId)
+  uint64_t llc = 0;
+
+  //! @brief system wide core ID (x2APIC ID without the SMT bits)
+  uint32_t core = 0;
+
+  //! @brief x2APIC ID
+  uint32_t x2apicId = 0;
+
+  //! @brief 0 for the first thread of a core, 1 for its sibling, ...
+  int smtRank = 0;
+
+  //! @brief Cpu::coreType
+  int coreType = CORE_TYPE_NONE;
+};
+
+
+//!
+//! @brief collect the placement attributes of every known processor
+//!
+static vector<Slot> collect_slots(const vector<Cpu> &cpus)
+{
+  vector<Slot> slots;
+
+  for (const Cpu &cpu : cpus)
+  {
+    Slot slot;
+    int level = 0;
+
+    if (cpu.cpuIndex < 0)
+      continue;
+    slot.cpu      = cpu.cpuIndex;
+    slot.x2apicId = cpu.x2apicId;
+    slot.coreType = cpu.coreType;
+    slot.core     = cpu.x2apicId;
+    for (const TopologyLevel &l : cpu.topology)
+    {
+      if (l.type == 1)
+        slot.core = (l.shift >= 32) ? 0 : (cpu.x2apicId >> l.shift);
+    }
+    for (const Cache &c : cpu.cache)
+    {
+      if (c.level > level)
+      {
+        level    = c.level;
+        slot.llc = (static_cast<uint64_t>(c.shareShift) << 32) | c.instanceId;
+      }
+    }
+    slots.push_back(slot);
+  }
+
+  // rank SMT siblings by x2APIC ID within each core
+  for (Slot &s : slots)
+  {
+    for (const Slot &o : slots)
+    {
+      if ((o.core == s.core) && (o.x2apicId < s.x2apicId))
+        ++s.smtRank;
+    }
+  }
+
+  return slots;
+}
+
+
+//!
+//! @brief order by SMT rank, then by processor number
+//!
+static bool by_smt_rank(const Slot &a, const Slot &b)
+{
+  if (a.smtRank != b.smtRank)
+    return a.smtRank < b.smtRank;
+  return a.cpu < b.cpu;
+}
+
+
+//!
+//! @brief group processors by last-level cache, each group by SMT rank
+//!
+static vector<vector<Slot>> group_by_llc(const vector<Slot> &slots)
+{
+  vector<vector<Slot>> groups;
+
+  for (const Slot &s : slots)
+  {
+    auto it = find_if(groups.begin(), groups.end(),
+                      [&](const vector<Slot> &g) { return g[0].llc == s.llc; });
+    if (it == groups.end())
+      groups.push_back(vector<Slot>(1, s));
+    else
+      it->push_back(s);
+  }
+  for (vector<Slot> &g : groups)
+    sort(g.begin(), g.end(), by_smt_rank);
+
+  return groups;
+}
+
+
+vector<int> libcpu::plan_placement(const vector<Cpu> &cpus, int threads,
+                                   PlacementPolicy policy)
+{
+  vector<Slot> slots = collect_slots(cpus);
+  vector<Slot> order;
+  vector<int> plan;
+
+  sort(slots.begin(), slots.end(),
+       [](const Slot &a, const Slot &b) { return a.cpu < b.cpu; });
+
+  switch (policy)
+  {
+  case PlacementPolicy::spreadLlc:
+  {
+    vector<vector<Slot>> groups = group_by_llc(slots);
+    for (size_t i = 0; order.size() < slots.size(); ++i)
+    {
+      for (const vector<Slot> &g : groups)
+        if (i < g.size())
+          order.push_back(g[i]);
+    }
+    break;
+  }
+  case PlacementPolicy::packLlc:
+  {
+    // largest domain first: it keeps the most threads on one cache
+    vector<vector<Slot>> groups = group_by_llc(slots);
+    stable_sort(groups.begin(), groups.end(),
+                [](const vector<Slot> &a, const vector<Slot> &b) {
+                  return a.size() > b.size();
+                });
+    for (const vector<Slot> &g : groups)
+      order.insert(order.end(), g.begin(), g.end());
+    break;
+  }
+  case PlacementPolicy::avoidSmt:
+    order = slots;
+    stable_sort(order.begin(), order.end(), by_smt_rank);
+    break;
+  case PlacementPolicy::performanceFirst:
+  {
+    auto tier = [](const Slot &s) {
+      if (s.smtRank > 0)
+        return 2;
+      return (s.coreType == CORE_TYPE_ATOM) ? 1 : 0;
+    };
+    order = slots;
+    stable_sort(order.begin(), order.end(),
+                [&](const Slot &a, const Slot &b) {
+                  if (tier(a) != tier(b))
+                    return tier(a) < tier(b);
+                  return by_smt_rank(a, b);
+                });
+    break;
+  }
+  }
+
+  if (order.empty())
+    return plan;
+  for (int i = 0; i < threads; ++i)
+    plan.push_back(order[i % order.size()].cpu);
+
+  return plan;
+}
+
+
+vector<int> libcpu::plan_placement(int threads, PlacementPolicy policy)
+{
+  static const vector<Cpu> cpus = []() {
+    vector<Cpu> all;
+    detect_cpu_info_all(&all);
+    return all;
+  }();
+
+  return plan_placement(cpus, threads, policy);
+}
+
+
+vector<int> libcpu::plan_placement(const CoreLatency &latency, int threads)
+{
+  size_t n = latency.cpus.size();
+  vector<size_t> chosen;
+  vector<bool> used(n, false);
+  vector<int> plan;
+
+  if (n == 0)
+    return plan;
+
+  // negative entries were not measured: treat them as the slowest
+  auto cost = [&](size_t i, size_t j) {
+    double ns = latency.at(i, j);
+    return (ns < 0.0) ? 1e30 : ns;
+  };
+
+  size_t first = 0, second = 0;
+  double pairCost = -1.0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t j = i + 1; j < n; ++j)
+    {
+      if ((pairCost < 0.0) || (cost(i, j) < pairCost))
+      {
+        first    = i;
+        second   = j;
+        pairCost = cost(i, j);
+      }
+    }
+  }
+  chosen.push_back(first);
+  used[first] = true;
+  if (n > 1)
+  {
+    chosen.push_back(second);
+    used[second] = true;
+  }
+
+  while (chosen.size() < n)
+  {
+    size_t best = n;
+    double bestCost = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      double worst = 0.0;
+      if (used[i])
+        continue;
+      for (size_t c : chosen)
+        worst = max(worst, cost(i, c));
+      if ((best == n) || (worst < bestCost))
+      {
+        best     = i;
+        bestCost = worst;
+      }
+    }
+    used[best] = true;
+    chosen.push_back(best);
+  }
+
+  for (int i = 0; i < threads; ++i)
+    plan.push_back(latency.cpus[chosen[i % n]]);
+
+  return plan;
+}
+
+
+bool libcpu::apply_placement(vector<thread> *threads, const vector<int> &plan)
+{
+  bool result = true;
+
+  for (size_t i = 0; i < threads->size(); ++i)
+  {
+    if (i >= plan.size())
+      return false;
+    result = set_thread_affinity(&(*threads)[i], vector<int>(1, plan[i])) &&
+             result;
+  }
+
+  return result;
+}
@@ -0,0 +1,91 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_PLACEMENT_H
+#define LIB_CPU_PLACEMENT_H
+
+#include <thread>
+#include <vector>
+
+#include "corelatency.h"
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief Thread placement policies
+//!
+enum class PlacementPolicy
+{
+  //! @brief round-robin across last-level cache domains, one thread per core
+  //!        before SMT siblings (memory bandwidth bound work)
+  spreadLlc,
+
+  //! @brief fill one last-level cache domain before the next, one thread per
+  //!        core before SMT siblings (threads sharing data)
+  packLlc,
+
+  //! @brief one thread per physical core before SMT siblings
+  avoidSmt,
+
+  //! @brief P-cores, then E-cores, then P-core SMT siblings (same as avoidSmt
+  //!        on non-hybrid parts)
+  performanceFirst
+};
+
+
+//!
+//! @brief plan the processor of each thread
+//!
+//! @param[in]    cpus      result of detect_cpu_info_all()
+//! @param[in]    threads   number of threads
+//! @param[in]    policy    placement policy
+//!
+//! @return OS logical processor of each thread (threads entries; wraps
+//!         around when there are more threads than processors, empty if no
+//!         processor is known)
+//!
+std::vector<int> plan_placement(const std::vector<Cpu> &cpus, int threads,
+                                PlacementPolicy policy);
+
+
+//!
+//! @brief plan the processor of each thread for the running system
+//!
+//! @note detect_cpu_info_all() runs on the first call only
+//!
+std::vector<int> plan_placement(int threads, PlacementPolicy policy);
+
+
+//!
+//! @brief plan the processors of threads that communicate with each other
+//!
+//! Starts from the pair with the fastest handoff and repeatedly adds the
+//! processor whose slowest round trip to the chosen ones is lowest, so the
+//! threads stay inside the tightest latency domain that can hold them.
+//!
+//! @param[in]    latency   result of measure_core_latency()
+//! @param[in]    threads   number of threads
+//!
+//! @return OS logical processor of each thread (wraps around when there are
+//!         more threads than processors)
+//!
+std::vector<int> plan_placement(const CoreLatency &latency, int threads);
+
+
+//!
+//! @brief pin running threads according to a plan
+//!
+//! @param[in]    threads   threads; threads[i] is pinned to plan[i]
+//! @param[in]    plan      result of plan_placement()
+//!
+//! @return true if every thread was pinned
+//!
+bool apply_placement(std::vector<std::thread> *threads,
+                     const std::vector<int> &plan);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_PLACEMENT_H
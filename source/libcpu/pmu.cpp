@@ -0,0 +1,299 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+#include <cstring>
+
+#include "pmu.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace libcpu;
+
+static const char *PMU_EVENT_NAME[] = { "cycles",         "instructions",
+                                        "ref-cycles",     "llc-references",
+                                        "llc-misses",     "branches",
+                                        "branch-misses" };
+
+
+vector<PmuEvent> libcpu::pmu_events(const Cpu &cpu)
+{
+  vector<PmuEvent> events;
+
+  if (cpu.apmVersion == 0)
+    return events;
+
+  // ordered so that dropping from the end keeps the most useful ratios
+  if (cpu.cce)
+    events.push_back(PmuEvent::cycles);
+  if (cpu.ire)
+    events.push_back(PmuEvent::instructions);
+  if (cpu.llcme)
+    events.push_back(PmuEvent::llcMisses);
+  if (cpu.llcre)
+    events.push_back(PmuEvent::llcReferences);
+  if (cpu.bmre)
+    events.push_back(PmuEvent::branchMisses);
+  if (cpu.bire)
+    events.push_back(PmuEvent::branches);
+  if (cpu.rce)
+    events.push_back(PmuEvent::refCycles);
+
+  return events;
+}
+
+
+const char *libcpu::pmu_event_name(PmuEvent event)
+{
+  return PMU_EVENT_NAME[static_cast<int>(event)];
+}
+
+
+#if defined(__linux__)
+
+//!
+//! @brief perf generic hardware event of an architectural event
+//!
+static uint64_t perf_config(PmuEvent event)
+{
+  switch (event)
+  {
+  case PmuEvent::cycles:
+    return PERF_COUNT_HW_CPU_CYCLES;
+  case PmuEvent::instructions:
+    return PERF_COUNT_HW_INSTRUCTIONS;
+  case PmuEvent::refCycles:
+    return PERF_COUNT_HW_REF_CPU_CYCLES;
+  case PmuEvent::llcReferences:
+    return PERF_COUNT_HW_CACHE_REFERENCES;
+  case PmuEvent::llcMisses:
+    return PERF_COUNT_HW_CACHE_MISSES;
+  case PmuEvent::branches:
+    return PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+  case PmuEvent::branchMisses:
+    return PERF_COUNT_HW_BRANCH_MISSES;
+  }
+  return PERF_COUNT_HW_CPU_CYCLES;
+}
+
+
+//!
+//! @brief open one event of the calling thread (user mode only)
+//!
+static int perf_open(PmuEvent event, int leader)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.config         = perf_config(event);
+  attr.disabled       = (leader < 0) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return static_cast<int>(
+    syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+}
+
+
+//!
+//! @brief read a counter in user space (seqlock of the mmapped page)
+//!
+//! @return false if the counter is not on a hardware counter right now
+//!
+static bool read_rdpmc(const void *page, uint64_t *value)
+{
+  const volatile perf_event_mmap_page *pc =
+    static_cast<const volatile perf_event_mmap_page *>(page);
+  uint32_t seq, index;
+  uint64_t count;
+
+  do
+  {
+    seq = pc->lock;
+    __asm__ __volatile__("" ::: "memory");
+
+    index = pc->index;
+    count = pc->offset;
+    if (!pc->cap_user_rdpmc || (index == 0))
+      return false;
+
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index - 1));
+    int shift = 64 - pc->pmc_width;
+    int64_t pmc = static_cast<int64_t>((static_cast<uint64_t>(hi) << 32) | lo);
+    count += static_cast<uint64_t>((pmc << shift) >> shift);
+
+    __asm__ __volatile__("" ::: "memory");
+  } while (pc->lock != seq);
+
+  *value = count;
+  return true;
+}
+
+
+//!
+//! @brief open a group; the leader is enabled and must get scheduled
+//!
+static bool open_group(const vector<PmuEvent> &events, vector<int> *fds)
+{
+  for (PmuEvent e : events)
+  {
+    int fd = perf_open(e, fds->empty() ? -1 : (*fds)[0]);
+    if (fd < 0)
+      break;
+    fds->push_back(fd);
+  }
+  if (fds->size() == events.size())
+  {
+    ioctl((*fds)[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl((*fds)[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // a group that does not fit on the counters never runs
+    uint64_t buffer[3 + PMU_EVENT_COUNT];
+    ssize_t n = ::read((*fds)[0], buffer, sizeof(buffer));
+    if ((n > 0) && (buffer[2] != 0))
+      return true;
+  }
+
+  for (int fd : *fds)
+    ::close(fd);
+  fds->clear();
+  return false;
+}
+
+
+bool libcpu::PmuGroup::open(const vector<PmuEvent> &request)
+{
+  close();
+
+  events.assign(request.begin(), request.begin() +
+                min<size_t>(request.size(), PMU_EVENT_COUNT));
+  while (!events.empty() && !open_group(events, &fds))
+    events.pop_back();
+  if (fds.empty())
+    return false;
+
+  long pageSize = sysconf(_SC_PAGESIZE);
+  rdpmc         = true;
+  for (int fd : fds)
+  {
+    void *page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED)
+    {
+      rdpmc = false;
+      break;
+    }
+    pages.push_back(page);
+    const perf_event_mmap_page *pc =
+      static_cast<const perf_event_mmap_page *>(page);
+    if (!pc->cap_user_rdpmc)
+      rdpmc = false;
+  }
+
+  begin.assign(events.size(), 0);
+  end.assign(events.size(), 0);
+  reset();
+  return true;
+}
+
+
+void libcpu::PmuGroup::close()
+{
+  long pageSize = sysconf(_SC_PAGESIZE);
+
+  for (void *page : pages)
+    munmap(page, pageSize);
+  for (int fd : fds)
+    ::close(fd);
+  pages.clear();
+  fds.clear();
+  events.clear();
+  rdpmc   = false;
+  started = false;
+}
+
+
+bool libcpu::PmuGroup::snapshot(uint64_t *values) const
+{
+  if (fds.empty())
+    return false;
+
+  if (rdpmc)
+  {
+    size_t i = 0;
+    while ((i < pages.size()) && read_rdpmc(pages[i], &values[i]))
+      ++i;
+    if (i == pages.size())
+      return true;
+  }
+
+  // nr, time_enabled, time_running, value[nr]
+  uint64_t buffer[3 + PMU_EVENT_COUNT];
+  ssize_t n = ::read(fds[0], buffer, sizeof(buffer));
+  if ((n < 24) || (buffer[0] != fds.size()))
+    return false;
+  memcpy(values, &buffer[3], fds.size() * sizeof(uint64_t));
+  return true;
+}
+
+#else
+
+bool libcpu::PmuGroup::open(const vector<PmuEvent> &)
+{
+  close();
+  return false;
+}
+
+
+void libcpu::PmuGroup::close()
+{
+  fds.clear();
+  pages.clear();
+  events.clear();
+  rdpmc   = false;
+  started = false;
+}
+
+
+bool libcpu::PmuGroup::snapshot(uint64_t *) const
+{
+  return false;
+}
+
+#endif
+
+
+void libcpu::PmuGroup::start()
+{
+  started = snapshot(begin.data());
+}
+
+
+void libcpu::PmuGroup::stop()
+{
+  if (!started || !snapshot(end.data()))
+    return;
+  started = false;
+  for (size_t i = 0; i < events.size(); ++i)
+    total.count[static_cast<int>(events[i])] += end[i] - begin[i];
+}
+
+
+void libcpu::PmuGroup::reset()
+{
+  total = PmuSample();
+  for (PmuEvent e : events)
+    total.valid[static_cast<int>(e)] = true;
+}
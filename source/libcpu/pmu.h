@@ -0,0 +1,184 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_PMU_H
+#define LIB_CPU_PMU_H
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief Architectural performance monitoring events (leaf 0AH EBX)
+//!
+enum class PmuEvent
+{
+  //! @brief UnHalted Core Cycles
+  cycles,
+
+  //! @brief Instructions Retired
+  instructions,
+
+  //! @brief UnHalted Reference Cycles
+  refCycles,
+
+  //! @brief LLC Reference
+  llcReferences,
+
+  //! @brief LLC Misses
+  llcMisses,
+
+  //! @brief Branch Instruction Retired
+  branches,
+
+  //! @brief Branch Mispredict Retired
+  branchMisses
+};
+
+//!
+//! @brief number of PmuEvent values
+//!
+static const int PMU_EVENT_COUNT = 7;
+
+//!
+//! @brief Counter values of a PMU group
+//!
+struct PmuSample
+{
+  //! @brief count per event, indexed by PmuEvent
+  uint64_t count[PMU_EVENT_COUNT] = {};
+
+  //! @brief event was part of the group, indexed by PmuEvent
+  bool valid[PMU_EVENT_COUNT] = {};
+
+  //! @brief count of an event (0 if it was not counted)
+  uint64_t get(PmuEvent event) const
+  {
+    return count[static_cast<int>(event)];
+  }
+
+  //! @brief instructions per core cycle (0 if either was not counted)
+  double ipc() const
+  {
+    uint64_t c = get(PmuEvent::cycles);
+    return (c != 0) ? static_cast<double>(get(PmuEvent::instructions)) / c
+                    : 0.0;
+  }
+};
+
+
+//!
+//! @brief architectural events advertised by a processor, most useful first
+//!
+//! @param[in]    cpu       cpu information
+//!
+//! @return events (empty if leaf 0AH reports no architectural PMU)
+//!
+std::vector<PmuEvent> pmu_events(const Cpu &cpu);
+
+
+//!
+//! @brief name of an event
+//!
+const char *pmu_event_name(PmuEvent event);
+
+
+//!
+//! @brief Group of user-mode counters of the calling thread
+//!
+//! The events are opened with perf_event_open as one group, so they are
+//! always scheduled together and their ratios are meaningful. Events that do
+//! not fit on the hardware counters are dropped from the end of the list.
+//! start() and stop() bracket a region and accumulate its counts; when the
+//! kernel allows user-space RDPMC the counters are read without a system
+//! call. A group must be used by the thread that opened it.
+//!
+//! @code
+//!   libcpu::PmuGroup pmu;
+//!   if (pmu.open())
+//!   {
+//!     pmu.start();
+//!     hot_loop();
+//!     pmu.stop();
+//!     printf("ipc %.2f\n", pmu.read().ipc());
+//!   }
+//! @endcode
+//!
+//! @note only implemented on Linux; open() fails elsewhere
+//!
+class PmuGroup
+{
+public:
+  PmuGroup() = default;
+  PmuGroup(const PmuGroup &) = delete;
+  PmuGroup &operator=(const PmuGroup &) = delete;
+  ~PmuGroup() { close(); }
+
+  //!
+  //! @brief open the events advertised by the running processor
+  //!
+  //! @return false if no event could be opened
+  //!
+  bool open() { return open(pmu_events(current())); }
+
+  //!
+  //! @brief open a group of events
+  //!
+  //! @param[in]    events    events in order of preference
+  //!
+  //! @return false if no event could be opened
+  //!
+  bool open(const std::vector<PmuEvent> &events);
+
+  //! @brief release the counters
+  void close();
+
+  //! @brief group is open
+  bool is_open() const { return !fds.empty(); }
+
+  //! @brief counters are read with RDPMC instead of read()
+  bool uses_rdpmc() const { return rdpmc; }
+
+  //! @brief events in the group
+  const std::vector<PmuEvent> &get_events() const { return events; }
+
+  //! @brief begin a region
+  void start();
+
+  //! @brief end a region and add its counts to the total
+  void stop();
+
+  //! @brief counts accumulated over all start()/stop() regions
+  const PmuSample &read() const { return total; }
+
+  //! @brief clear the accumulated counts
+  void reset();
+
+  //!
+  //! @brief current raw counter values
+  //!
+  //! @param[out]   values    one value per event of the group
+  //!
+  //! @return false if the counters could not be read
+  //!
+  bool snapshot(uint64_t *values) const;
+
+private:
+  std::vector<PmuEvent> events;
+  std::vector<int> fds;
+  std::vector<void *> pages;
+  std::vector<uint64_t> begin;
+  std::vector<uint64_t> end;
+  PmuSample total;
+  bool rdpmc   = false;
+  bool started = false;
+};
+
+} // namespace libcpu
+
+#endif // LIB_CPU_PMU_H
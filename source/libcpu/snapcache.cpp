@@ -0,0 +1,194 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "snapcache.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace libcpu;
+
+static_assert(is_trivially_copyable<CpuidSnapshot>::value,
+              "CpuidSnapshot is written to disk as is");
+static_assert(is_trivially_copyable<FeatureSet>::value,
+              "FeatureSet is written to disk as is");
+
+static const char SNAPSHOT_MAGIC[8] = { 'L', 'I', 'B', 'C', 'P', 'U', 0, 0 };
+
+
+#if defined(__linux__)
+
+//!
+//! @brief read the first line of a small file
+//!
+static string read_line(const char *path)
+{
+  char buffer[64] = "";
+  FILE *fp = fopen(path, "r");
+
+  if (fp == nullptr)
+    return string();
+  if (fgets(buffer, sizeof(buffer), fp) == nullptr)
+    buffer[0] = '\0';
+  fclose(fp);
+
+  buffer[strcspn(buffer, "\n")] = '\0';
+  return buffer;
+}
+
+
+//!
+//! @brief identity of the running boot
+//!
+static void current_boot(char bootId[40], uint64_t *microcode)
+{
+  string id = read_line("/proc/sys/kernel/random/boot_id");
+  string mc = read_line("/sys/devices/system/cpu/cpu0/microcode/version");
+
+  memset(bootId, 0, 40);
+  strncpy(bootId, id.c_str(), 39);
+  *microcode = strtoull(mc.c_str(), nullptr, 0);
+}
+
+
+const SnapshotFile *libcpu::map_snapshot_cache(const char *path)
+{
+  struct stat st;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    return nullptr;
+
+  // a file other users could have planted would decide our code paths
+  if ((fstat(fd, &st) != 0) || (st.st_size != sizeof(SnapshotFile)) ||
+      ((st.st_uid != 0) && (st.st_uid != geteuid())))
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  void *map = mmap(nullptr, sizeof(SnapshotFile), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return nullptr;
+
+  const SnapshotFile *file = static_cast<const SnapshotFile *>(map);
+  char bootId[40];
+  uint64_t microcode;
+
+  current_boot(bootId, &microcode);
+  if ((memcmp(file->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) ||
+      (file->version != SNAPSHOT_CACHE_VERSION) ||
+      (file->size != sizeof(SnapshotFile)) ||
+      (file->featureCount != static_cast<uint32_t>(Feature::count)) ||
+      (bootId[0] == '\0') ||
+      (memcmp(file->bootId, bootId, sizeof(bootId)) != 0) ||
+      (file->microcode != microcode) || (file->snapshot.count < 0) ||
+      (file->snapshot.count > CpuidSnapshot::CPUID_SNAPSHOT_CAPACITY))
+  {
+    munmap(map, sizeof(SnapshotFile));
+    return nullptr;
+  }
+
+  return file;
+}
+
+
+void libcpu::unmap_snapshot_cache(const SnapshotFile *file)
+{
+  if (file != nullptr)
+    munmap(const_cast<SnapshotFile *>(file), sizeof(SnapshotFile));
+}
+
+
+bool libcpu::write_snapshot_cache(const CpuidSnapshot &snapshot,
+                                  const char *path)
+{
+  // value-initialized: reserved fields and padding are written as zeros
+  SnapshotFile *file = new SnapshotFile();
+  Cpu cpu;
+
+  detect_cpu_info(&cpu, snapshot);
+
+  memcpy(file->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  file->version      = SNAPSHOT_CACHE_VERSION;
+  file->size         = sizeof(SnapshotFile);
+  file->featureCount = static_cast<uint32_t>(Feature::count);
+  current_boot(file->bootId, &file->microcode);
+  file->features     = cpu.features;
+  file->snapshot     = snapshot;
+
+  string dir(path);
+  size_t slash = dir.rfind('/');
+  if ((slash != string::npos) && (slash != 0))
+    mkdir(dir.substr(0, slash).c_str(), 0755);
+
+  // readers only ever see a complete file
+  string temp = string(path) + "." + to_string(getpid());
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = false;
+
+  if (fd >= 0)
+  {
+    ok = write(fd, file, sizeof(SnapshotFile)) ==
+         static_cast<ssize_t>(sizeof(SnapshotFile));
+    close(fd);
+    ok = ok && (rename(temp.c_str(), path) == 0);
+    if (!ok)
+      unlink(temp.c_str());
+  }
+
+  delete file;
+  return ok;
+}
+
+#else
+
+const SnapshotFile *libcpu::map_snapshot_cache(const char *)
+{
+  return nullptr;
+}
+
+
+void libcpu::unmap_snapshot_cache(const SnapshotFile *)
+{
+}
+
+
+bool libcpu::write_snapshot_cache(const CpuidSnapshot &, const char *)
+{
+  return false;
+}
+
+#endif
+
+
+bool libcpu::detect_cpu_info_cached(Cpu *cpu, const char *path)
+{
+  const SnapshotFile *file = map_snapshot_cache(path);
+
+  if (file != nullptr)
+  {
+    detect_cpu_info(cpu, file->snapshot);
+    unmap_snapshot_cache(file);
+    return true;
+  }
+
+  CpuidSnapshot snapshot;
+  capture_cpuid(&snapshot);
+  detect_cpu_info(cpu, snapshot);
+  write_snapshot_cache(snapshot, path);
+  return false;
+}
@@ -0,0 +1,112 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_SNAPCACHE_H
+#define LIB_CPU_SNAPCACHE_H
+
+#include <cstdint>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief default location of the snapshot cache
+//!
+static const char SNAPSHOT_CACHE_PATH[] = "/run/libcpu/snapshot.bin";
+
+//!
+//! @brief layout version; bump whenever SnapshotFile or Feature changes
+//!
+static const uint32_t SNAPSHOT_CACHE_VERSION = 2;
+
+//!
+//! @brief On-disk detection result, mapped as is
+//!
+//! The file holds the raw CPUID snapshot, which every other field of Cpu is
+//! decoded from without executing CPUID, and the packed feature set, which
+//! can be queried straight from the mapping. It is only valid for the boot
+//! and microcode revision that wrote it.
+//!
+struct SnapshotFile
+{
+  //! @brief "LIBCPU" followed by zeros
+  char magic[8];
+
+  //! @brief SNAPSHOT_CACHE_VERSION
+  uint32_t version;
+
+  //! @brief sizeof(SnapshotFile)
+  uint32_t size;
+
+  //! @brief number of Feature values
+  uint32_t featureCount;
+
+  uint32_t reserved;
+
+  //! @brief kernel boot ID of the boot that wrote the file
+  char bootId[40];
+
+  //! @brief microcode revision of cpu0 (0 if unknown)
+  uint64_t microcode;
+
+  //! @brief features decoded from the snapshot
+  FeatureSet features;
+
+  //! @brief raw CPUID snapshot
+  CpuidSnapshot snapshot;
+};
+
+
+//!
+//! @brief map a snapshot cache read-only and check that it is current
+//!
+//! The file is rejected if its layout, boot ID or microcode revision does
+//! not match, or if it is owned by a user other than root and the caller.
+//!
+//! @param[in]    path      file name
+//!
+//! @return mapped file (release with unmap_snapshot_cache()), nullptr if
+//!         missing or stale
+//!
+const SnapshotFile *map_snapshot_cache(const char *path = SNAPSHOT_CACHE_PATH);
+
+
+//!
+//! @brief release a mapping returned by map_snapshot_cache()
+//!
+//! @param[in]    file      mapped file, nullptr is ignored
+//!
+void unmap_snapshot_cache(const SnapshotFile *file);
+
+
+//!
+//! @brief write a snapshot cache (atomically replaced, mode 0644)
+//!
+//! @param[in]    snapshot  snapshot taken by capture_cpuid()
+//! @param[in]    path      file name; the parent directory is created
+//!
+//! @return false on failure
+//!
+bool write_snapshot_cache(const CpuidSnapshot &snapshot,
+                          const char *path = SNAPSHOT_CACHE_PATH);
+
+
+//!
+//! @brief detect the cpu information through a snapshot cache
+//!
+//! Decodes the cached snapshot when it is current. Otherwise captures a new
+//! snapshot on the calling thread and tries to write it for later processes.
+//!
+//! @param[out]   cpu       decoded cpu information
+//! @param[in]    path      file name
+//!
+//! @return true if the cached snapshot was used
+//!
+bool detect_cpu_info_cached(Cpu *cpu, const char *path = SNAPSHOT_CACHE_PATH);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_SNAPCACHE_H
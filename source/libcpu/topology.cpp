@@ -0,0 +1,309 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+
+#include "affinity.h"
+#include "blocking.h"
+#include "topology.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief read the x2APIC ID of the logical processor running the caller
+//!
+static uint32_t read_x2apic_id()
+{
+  uint32_t stdLevel = cpuid(0).eax;
+
+  if ((stdLevel >= 0x1F) && (cpuid(0x1F, 0).ebx & 0xffff))
+    return cpuid(0x1F, 0).edx;
+  if ((stdLevel >= 0x0B) && (cpuid(0x0B, 0).ebx & 0xffff))
+    return cpuid(0x0B, 0).edx;
+  return (cpuid(1).ebx >> 24) & 0xff;
+}
+
+
+//!
+//! @brief read the leaf 8000001EH node ID of the logical processor running
+//!        the caller
+//!
+static int read_node_id()
+{
+  return static_cast<int>(cpuid(0x8000001E).ecx & 0xff);
+}
+
+
+//!
+//! @brief number of distinct values
+//!
+template <typename T>
+static int count_distinct(vector<T> values)
+{
+  sort(values.begin(), values.end());
+  return static_cast<int>(unique(values.begin(), values.end()) -
+                          values.begin());
+}
+
+
+//!
+//! @brief add a processor to the instance of a cache it uses
+//!
+static void add_cache_instance(vector<CacheInstance> *instances,
+                               const Cache &cache, uint32_t x2apicId,
+                               int index)
+{
+  uint32_t id = (cache.shareShift >= 32) ? 0 : (x2apicId >> cache.shareShift);
+  CacheInstance *instance = nullptr;
+
+  for (CacheInstance &i : *instances)
+  {
+    if ((i.level == cache.level) && (i.type == cache.type) &&
+        (i.shareShift == cache.shareShift) && (i.id == id))
+    {
+      instance = &i;
+      break;
+    }
+  }
+
+  if (instance == nullptr)
+  {
+    instances->push_back(CacheInstance());
+    instance             = &instances->back();
+    instance->level      = cache.level;
+    instance->type       = cache.type;
+    instance->shareShift = cache.shareShift;
+    instance->id         = id;
+    instance->size       = cache.size;
+  }
+
+  if (index >= 0)
+    instance->cpus.push_back(index);
+}
+
+
+//!
+//! @brief order instances by level, type and ID and their processors
+//!
+static void sort_cache_instances(vector<CacheInstance> *instances)
+{
+  for (CacheInstance &i : *instances)
+    sort(i.cpus.begin(), i.cpus.end());
+
+  sort(instances->begin(), instances->end(),
+       [](const CacheInstance &a, const CacheInstance &b) {
+         if (a.level != b.level)
+           return a.level < b.level;
+         if (a.type != b.type)
+           return a.type < b.type;
+         if (a.shareShift != b.shareShift)
+           return a.shareShift < b.shareShift;
+         return a.id < b.id;
+       });
+}
+
+
+void libcpu::decode_x2apic_id(const vector<TopologyLevel> &levels,
+                              uint32_t x2apicId, LogicalCpu *out)
+{
+  int prevShift = 0;
+
+  out->x2apicId = x2apicId;
+  out->package  = 0;
+  out->die      = 0;
+  out->complex  = 0;
+  out->tile     = 0;
+  out->module   = 0;
+  out->core     = 0;
+  out->thread   = 0;
+  out->coreId   = x2apicId;
+
+  for (const TopologyLevel &level : levels)
+  {
+    int width = level.shift - prevShift;
+    int id;
+
+    if (width < 0)
+      continue;
+    id = (width >= 32) ? static_cast<int>(x2apicId >> prevShift) :
+                         static_cast<int>((x2apicId >> prevShift) &
+                                          ((1u << width) - 1));
+
+    switch (level.type)
+    {
+    case 1: // SMT
+      out->thread = id;
+      out->coreId = (level.shift >= 32) ? 0 : (x2apicId >> level.shift);
+      break;
+    case 2: // core
+      out->core = id;
+      break;
+    case 3: // module
+      out->module = id;
+      break;
+    case 4: // tile
+      out->tile = id;
+      break;
+    case 5: // die
+      out->die = id;
+      break;
+    case 7: // AMD core complex
+      out->complex = id;
+      break;
+    default: // die group and unknown levels are folded into the package
+      break;
+    }
+    prevShift = level.shift;
+  }
+
+  out->package = (prevShift >= 32) ? 0 :
+                                     static_cast<int>(x2apicId >> prevShift);
+}
+
+
+bool libcpu::detect_topology(const Cpu &cpu, Topology *topology)
+{
+  vector<int> saved;
+  vector<int> cpus = online_cpus();
+  vector<uint64_t> packages, dies, complexes;
+  vector<uint32_t> cores;
+  bool restore = get_thread_affinity(&saved);
+  const Cache *l3 = nullptr;
+  int llc = last_level_cache(cpu);
+  bool hasDie, hasComplex;
+
+  topology->levels = cpu.topology;
+  topology->cpus.clear();
+
+  for (int index : cpus)
+  {
+    LogicalCpu logical;
+
+    if (!pin_thread(index))
+      continue;
+    logical.index = index;
+    decode_x2apic_id(cpu.topology, read_x2apic_id(), &logical);
+    if (cpu.topoExt)
+      logical.node = read_node_id();
+    topology->cpus.push_back(logical);
+  }
+
+  if (restore)
+    set_thread_affinity(saved);
+
+  // affinity is not available: describe the calling processor only
+  if (topology->cpus.empty())
+  {
+    LogicalCpu logical;
+    decode_x2apic_id(cpu.topology, cpu.x2apicId, &logical);
+    if (cpu.topoExt)
+      logical.node = cpu.nodeId;
+    topology->cpus.push_back(logical);
+  }
+
+  // without leaf 80000026H (Zen 1-3), the node is the CCD and each L3
+  // instance is a CCX
+  hasDie     = any_of(topology->levels.begin(), topology->levels.end(),
+                      [](const TopologyLevel &l) { return l.type == 5; });
+  hasComplex = any_of(topology->levels.begin(), topology->levels.end(),
+                      [](const TopologyLevel &l) { return l.type == 7; });
+  for (const Cache &cache : cpu.cache)
+  {
+    if ((cache.level == llc) && (cache.type != 2))
+      l3 = &cache;
+  }
+  if (cpu.topoExt)
+  {
+    for (LogicalCpu &c : topology->cpus)
+    {
+      if (!hasDie && (c.node >= 0))
+        c.die = c.node;
+      if (!hasComplex && (l3 != nullptr))
+        c.complex = (l3->shareShift >= 32) ?
+                      0 : static_cast<int>(c.x2apicId >> l3->shareShift);
+    }
+    hasComplex = hasComplex || (l3 != nullptr);
+  }
+
+  for (const LogicalCpu &c : topology->cpus)
+  {
+    packages.push_back(static_cast<uint64_t>(c.package));
+    dies.push_back((static_cast<uint64_t>(c.package) << 32) |
+                   static_cast<uint32_t>(c.die));
+    complexes.push_back((static_cast<uint64_t>(c.package) << 32) |
+                        (static_cast<uint32_t>(c.die) << 16) |
+                        static_cast<uint32_t>(c.complex));
+    cores.push_back(c.coreId);
+  }
+  topology->packages  = count_distinct(packages);
+  topology->dies      = count_distinct(dies);
+  topology->complexes = hasComplex ? count_distinct(complexes) : 0;
+  topology->cores     = count_distinct(cores);
+  topology->threads   = static_cast<int>(topology->cpus.size());
+
+  topology->caches.clear();
+  for (const LogicalCpu &c : topology->cpus)
+  {
+    for (const Cache &cache : cpu.cache)
+      add_cache_instance(&topology->caches, cache, c.x2apicId, c.index);
+  }
+  sort_cache_instances(&topology->caches);
+
+  return topology->cpus[0].index >= 0;
+}
+
+
+bool libcpu::detect_topology(Topology *topology)
+{
+  return detect_topology(current(), topology);
+}
+
+
+void libcpu::assign_cache_sharing(Cpu *cpu, const Topology &topology)
+{
+  for (Cache &cache : cpu->cache)
+  {
+    cache.sharedCpus.clear();
+    for (const CacheInstance &i : topology.caches)
+    {
+      if ((i.level == cache.level) && (i.type == cache.type) &&
+          (i.shareShift == cache.shareShift) && (i.id == cache.instanceId))
+      {
+        cache.sharedCpus = i.cpus;
+        break;
+      }
+    }
+  }
+}
+
+
+vector<CacheInstance> libcpu::cache_instances(const vector<Cpu> &cpus)
+{
+  vector<CacheInstance> instances;
+
+  for (const Cpu &cpu : cpus)
+  {
+    for (const Cache &cache : cpu.cache)
+      add_cache_instance(&instances, cache, cpu.x2apicId, cpu.cpuIndex);
+  }
+  sort_cache_instances(&instances);
+
+  return instances;
+}
+
+
+vector<CacheInstance> libcpu::cache_instances_at(
+  const vector<CacheInstance> &instances, int level, int type)
+{
+  vector<CacheInstance> result;
+
+  for (const CacheInstance &i : instances)
+  {
+    if ((i.level == level) && ((type == 0) || (i.type == type)))
+      result.push_back(i);
+  }
+
+  return result;
+}
@@ -0,0 +1,186 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_TOPOLOGY_H
+#define LIB_CPU_TOPOLOGY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu.h"
+
+namespace libcpu {
+
+//!
+//! @brief Topology coordinates of one logical processor
+//!
+struct LogicalCpu
+{
+  //! @brief OS logical processor number
+  int index = -1;
+
+  //! @brief x2APIC ID (initial APIC ID on processors without leaf 0BH)
+  uint32_t x2apicId = 0;
+
+  //! @brief package (socket) ID
+  int package = 0;
+
+  //! @brief die ID within the package; on AMD processors without a die
+  //!        level, the node ID of leaf 8000001EH (the CCD)
+  int die = 0;
+
+  //! @brief core complex (AMD CCX) ID within the die; on AMD processors
+  //!        without a complex level, the ID of the L3 instance
+  int complex = 0;
+
+  //! @brief AMD node ID read from leaf 8000001EH on the processor itself
+  //!        (-1 if the leaf is not available)
+  int node = -1;
+
+  //! @brief tile ID within the die
+  int tile = 0;
+
+  //! @brief module ID within the tile
+  int module = 0;
+
+  //! @brief core ID within the module
+  int core = 0;
+
+  //! @brief SMT thread ID within the core
+  int thread = 0;
+
+  //! @brief system wide unique core ID (x2APIC ID without the SMT bits).
+  //!        Logical processors with the same coreId are SMT siblings
+  uint32_t coreId = 0;
+};
+
+//!
+//! @brief One physical instance of a cache and the processors sharing it
+//!
+struct CacheInstance
+{
+  //! @brief cache level (start at 1)
+  int level = 0;
+
+  //! @brief cache type (Cache::type)
+  int type = 0;
+
+  //! @brief x2APIC ID bits below the instance (Cache::shareShift)
+  int shareShift = 0;
+
+  //! @brief instance ID (x2APIC ID >> shareShift)
+  uint32_t id = 0;
+
+  //! @brief cache KB size
+  int size = 0;
+
+  //! @brief OS logical processors sharing the instance, ascending
+  std::vector<int> cpus;
+};
+
+//!
+//! @brief Topology of every logical processor available to the process
+//!
+struct Topology
+{
+  //! @brief level shift widths (same for every logical processor)
+  std::vector<TopologyLevel> levels;
+
+  //! @brief logical processors ordered by OS number
+  std::vector<LogicalCpu> cpus;
+
+  //! @brief number of distinct packages
+  int packages = 0;
+
+  //! @brief number of distinct dies
+  int dies = 0;
+
+  //! @brief number of distinct core complexes (AMD CCX, from the complex
+  //!        level or the L3 instances; 0 if not reported)
+  int complexes = 0;
+
+  //! @brief number of distinct cores
+  int cores = 0;
+
+  //! @brief number of logical processors
+  int threads = 0;
+
+  //! @brief distinct cache instances ordered by level, type and ID
+  std::vector<CacheInstance> caches;
+};
+
+
+//!
+//! @brief split an x2APIC ID into topology coordinates
+//!
+//! @param[in]    levels    topology levels (Cpu::topology)
+//! @param[in]    x2apicId  x2APIC ID
+//! @param[out]   out       coordinates (index is left untouched)
+//!
+void decode_x2apic_id(const std::vector<TopologyLevel> &levels,
+                      uint32_t x2apicId, LogicalCpu *out);
+
+
+//!
+//! @brief enumerate the topology of every available logical processor
+//!
+//! The calling thread is pinned to each logical processor in turn to read
+//! its x2APIC ID (and on AMD its leaf 8000001EH node ID); its original
+//! affinity is restored afterwards.
+//!
+//! @param[in]    cpu       decoded information of the calling processor
+//! @param[out]   topology  topology
+//!
+//! @return true on success. false if the affinity of the calling thread
+//!         could not be changed; topology then describes the calling
+//!         processor only
+//!
+bool detect_topology(const Cpu &cpu, Topology *topology);
+
+
+//!
+//! @brief enumerate the topology using current()
+//!
+bool detect_topology(Topology *topology);
+
+
+//!
+//! @brief fill Cache::sharedCpus from the cache instances of a topology
+//!
+//! @param[in,out]  cpu       decoded information of the processor
+//! @param[in]      topology  result of detect_topology()
+//!
+void assign_cache_sharing(Cpu *cpu, const Topology &topology);
+
+
+//!
+//! @brief distinct cache instances of the result of detect_cpu_info_all()
+//!
+//! Unlike detect_topology(), which applies the sharing widths of the calling
+//! processor to all of them, each processor's own leaf 04H is used, so the
+//! result is exact on hybrid parts.
+//!
+//! @param[in]    cpus      per processor information
+//!
+//! @return instances ordered by level, type and ID
+//!
+std::vector<CacheInstance> cache_instances(const std::vector<Cpu> &cpus);
+
+
+//!
+//! @brief cache instances of one level
+//!
+//! @param[in]    instances Topology::caches or cache_instances()
+//! @param[in]    level     cache level (start at 1)
+//! @param[in]    type      cache type, 0 for every type
+//!
+//! @return matching instances, in the same order
+//!
+std::vector<CacheInstance> cache_instances_at(
+  const std::vector<CacheInstance> &instances, int level, int type = 0);
+
+} // namespace libcpu
+
+#endif // LIB_CPU_TOPOLOGY_H
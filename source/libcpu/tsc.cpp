@@ -0,0 +1,130 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+#include <mutex>
+
+#include "cpu.h"
+#include "tsc.h"
+
+using namespace std;
+using namespace libcpu;
+
+TscScale libcpu::tscScale;
+
+constexpr bool libcpu::tsc_clock::is_steady;
+
+//! @brief serializes the first initialization
+static once_flag tscOnce;
+
+
+//!
+//! @brief OS monotonic clock (in ns)
+//!
+static uint64_t monotonic_ns()
+{
+#if defined(_WIN32)
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return static_cast<uint64_t>(static_cast<double>(counter.QuadPart) * 1e9 /
+                               static_cast<double>(frequency.QuadPart));
+#elif defined(__linux__)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 +
+         static_cast<uint64_t>(ts.tv_nsec);
+#else
+  return static_cast<uint64_t>(
+    chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+
+//!
+//! @brief read the OS clock and the TSC as close together as possible
+//!
+//! @return OS clock (in ns); *cycles is the TSC taken between two OS clock
+//!         reads, the pair with the shortest gap out of a few attempts
+//!
+static uint64_t paired_read(uint64_t *cycles)
+{
+  uint64_t best = ~static_cast<uint64_t>(0), ns = 0;
+
+  for (int i = 0; i < 5; ++i)
+  {
+    uint64_t t0 = monotonic_ns();
+    uint64_t c  = rdtsc();
+    uint64_t t1 = monotonic_ns();
+    if (t1 - t0 < best)
+    {
+      best    = t1 - t0;
+      ns      = t0 + (t1 - t0) / 2;
+      *cycles = c;
+    }
+  }
+
+  return ns;
+}
+
+
+uint64_t libcpu::calibrate_tsc_frequency(int milliseconds)
+{
+  uint64_t c0, c1, t0, t1;
+  uint64_t duration = static_cast<uint64_t>(milliseconds > 0 ? milliseconds : 1)
+                      * 1000000;
+
+  t0 = paired_read(&c0);
+  while (monotonic_ns() - t0 < duration)
+    ;
+  t1 = paired_read(&c1);
+
+  return static_cast<uint64_t>(static_cast<double>(c1 - c0) * 1e9 /
+                               static_cast<double>(t1 - t0));
+}
+
+
+//!
+//! @brief publish a frequency (nothing is published for 0)
+//!
+static uint64_t store_scale(uint64_t hz)
+{
+  if (hz == 0)
+    return 0;
+
+  uint64_t mult = (static_cast<uint64_t>(1000000000) << TscScale::SHIFT) / hz;
+
+  tscScale.frequency.store(hz, memory_order_relaxed);
+  tscScale.mult.store(mult, memory_order_relaxed);
+
+  return mult;
+}
+
+
+uint64_t libcpu::init_tsc_scale()
+{
+  call_once(tscOnce, []() {
+    if (tscScale.mult.load() != 0)
+      return;
+    uint64_t hz = current().tscFrequency;
+    if (hz == 0)
+      hz = calibrate_tsc_frequency();
+    store_scale(hz);
+  });
+
+  return tscScale.mult.load(memory_order_relaxed);
+}
+
+
+void libcpu::tsc_clock::set_frequency(uint64_t hz)
+{
+  if (hz != 0)
+    store_scale(hz);
+}
@@ -0,0 +1,146 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_TSC_H
+#define LIB_CPU_TSC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace libcpu {
+
+//!
+//! @brief read the time stamp counter
+//!
+inline uint64_t rdtsc()
+{
+  return __rdtsc();
+}
+
+
+//!
+//! @brief read the time stamp counter after every earlier instruction
+//!
+//! RDTSC alone may execute before preceding loads or a lock acquisition
+//! complete; the LFENCE keeps it in program order (as Linux rdtsc_ordered()).
+//!
+inline uint64_t rdtsc_ordered()
+{
+  _mm_lfence();
+  return __rdtsc();
+}
+
+
+//!
+//! @brief (a * b) >> shift without overflowing the product
+//!
+inline uint64_t mul_shift(uint64_t a, uint64_t b, int shift)
+{
+#if defined(_MSC_VER)
+  uint64_t hi, lo = _umul128(a, b, &hi);
+  return (shift == 0) ? lo : ((lo >> shift) | (hi << (64 - shift)));
+#else
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >>
+                               shift);
+#endif
+}
+
+
+//!
+//! @brief measure the TSC frequency against the OS monotonic clock
+//!        (CLOCK_MONOTONIC_RAW on Linux, QueryPerformanceCounter on Windows)
+//!
+//! @param[in]    milliseconds  measurement duration
+//!
+//! @return TSC frequency (in Hz)
+//!
+uint64_t calibrate_tsc_frequency(int milliseconds = 20);
+
+
+//!
+//! @brief Fixed-point conversion from TSC cycles to nanoseconds
+//!
+struct TscScale
+{
+  //! @brief fraction bits of mult
+  enum { SHIFT = 32 };
+
+  //! @brief nanoseconds per cycle << SHIFT (0 until initialized)
+  std::atomic<uint64_t> mult;
+
+  //! @brief TSC frequency (in Hz)
+  std::atomic<uint64_t> frequency;
+};
+
+//! @brief scale used by tsc_clock (zero-initialized, set on first use)
+extern TscScale tscScale;
+
+
+//!
+//! @brief initialize tscScale from current() or by calibration
+//!
+//! @return mult, 0 if no frequency could be determined
+//!
+uint64_t init_tsc_scale();
+
+
+//!
+//! @brief std::chrono clock reading the TSC
+//!
+//! now() is a RDTSC and a 64x64 bit multiply; the frequency is taken from
+//! CPUID (leaf 15H/16H or the brand string) or calibrated once on first use.
+//!
+//! @note the clock is only steady and comparable between threads when the
+//!       TSC is invariant and synchronized across processors; see
+//!       tsc_reliable()
+//!
+class tsc_clock
+{
+public:
+  typedef std::chrono::nanoseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<tsc_clock> time_point;
+
+  static constexpr bool is_steady = true;
+
+  //! @brief current time
+  static time_point now() noexcept
+  {
+    return time_point(duration(static_cast<rep>(to_ns(rdtsc()))));
+  }
+
+  //! @brief convert cycles to nanoseconds (0 if the TSC frequency could be
+  //!        neither read nor calibrated, e.g. when the TSC does not advance)
+  static uint64_t to_ns(uint64_t cycles) noexcept
+  {
+    uint64_t mult = tscScale.mult.load(std::memory_order_relaxed);
+    if (mult == 0)
+      mult = init_tsc_scale();
+    return mul_shift(cycles, mult, TscScale::SHIFT);
+  }
+
+  //! @brief TSC frequency used for the conversion (in Hz, 0 if unknown)
+  static uint64_t frequency() noexcept
+  {
+    if (tscScale.mult.load(std::memory_order_relaxed) == 0)
+      init_tsc_scale();
+    return tscScale.frequency.load(std::memory_order_relaxed);
+  }
+
+  //! @brief override the frequency (e.g. with a calibrated value)
+  static void set_frequency(uint64_t hz);
+};
+
+} // namespace libcpu
+
+#endif // LIB_CPU_TSC_H
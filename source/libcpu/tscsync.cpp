@@ -0,0 +1,194 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "affinity.h"
+#include "cpu.h"
+#include "tsc.h"
+#include "tscsync.h"
+
+using namespace std;
+using namespace libcpu;
+
+//!
+//! @brief state shared by a processor pair, each member on its own line
+//!
+struct TscExchange
+{
+  //! @brief handoff sequence number
+  alignas(64) atomic<int> step;
+
+  //! @brief TSC read by the remote processor
+  alignas(64) atomic<uint64_t> remote;
+
+  //! @brief serializes the monotonicity test
+  alignas(64) atomic<bool> lock;
+
+  //! @brief last TSC read under the lock
+  uint64_t last;
+
+  //! @brief monotonicity test results
+  uint64_t violations;
+  uint64_t maxWarp;
+};
+
+
+//!
+//! @brief spin until the step reaches a value
+//!
+static void wait_step(const TscExchange &exchange, int value)
+{
+  for (int spins = 0; exchange.step.load(memory_order_acquire) != value;
+       ++spins)
+  {
+    if ((spins & 0xffff) == 0xffff)
+      this_thread::yield();
+  }
+}
+
+
+//!
+//! @brief read the TSC under the lock and count backward steps
+//!
+static void monotonic_reads(TscExchange *exchange, int iterations)
+{
+  for (int i = 0; i < iterations; ++i)
+  {
+    while (exchange->lock.exchange(true, memory_order_acquire))
+      ;
+    uint64_t now = rdtsc_ordered();
+    if (now < exchange->last)
+    {
+      exchange->violations++;
+      exchange->maxWarp = max(exchange->maxWarp, exchange->last - now);
+    }
+    exchange->last = now;
+    exchange->lock.store(false, memory_order_release);
+  }
+}
+
+
+//!
+//! @brief measure one processor against the reference
+//!
+//! @return false if a thread could not be pinned
+//!
+static bool check_pair(int reference, int cpu, const TscSyncOptions &options,
+                       int64_t *offset, int64_t *uncertainty,
+                       uint64_t *violations, uint64_t *maxWarp)
+{
+  TscExchange exchange;
+  atomic<bool> pinned(true);
+  atomic<int> ready(0);
+  int samples = max(options.samples, 1);
+
+  exchange.step.store(0);
+  exchange.remote.store(0);
+  exchange.lock.store(false);
+  exchange.last       = 0;
+  exchange.violations = 0;
+  exchange.maxWarp    = 0;
+
+  thread remote([&]() {
+    if (!pin_thread(cpu))
+      pinned.store(false);
+    for (int s = 0; s < samples; ++s)
+    {
+      wait_step(exchange, 2 * s + 1);
+      exchange.remote.store(rdtsc_ordered(), memory_order_relaxed);
+      exchange.step.store(2 * s + 2, memory_order_release);
+    }
+    ready.fetch_add(1);
+    while (ready.load() < 2)
+      ;
+    monotonic_reads(&exchange, options.iterations);
+  });
+
+  thread home([&]() {
+    uint64_t best = ~static_cast<uint64_t>(0);
+    if (!pin_thread(reference))
+      pinned.store(false);
+    for (int s = 0; s < samples; ++s)
+    {
+      uint64_t t0 = rdtsc_ordered();
+      exchange.step.store(2 * s + 1, memory_order_release);
+      wait_step(exchange, 2 * s + 2);
+      uint64_t t2 = rdtsc_ordered();
+      uint64_t t1 = exchange.remote.load(memory_order_relaxed);
+      if (t2 - t0 < best)
+      {
+        best         = t2 - t0;
+        *offset      = static_cast<int64_t>(t1 - (t0 + (t2 - t0) / 2));
+        *uncertainty = static_cast<int64_t>((t2 - t0) / 2);
+      }
+    }
+    ready.fetch_add(1);
+    while (ready.load() < 2)
+      ;
+    monotonic_reads(&exchange, options.iterations);
+  });
+
+  remote.join();
+  home.join();
+
+  *violations = exchange.violations;
+  *maxWarp    = exchange.maxWarp;
+
+  return pinned.load();
+}
+
+
+bool libcpu::check_tsc_sync(const TscSyncOptions &options, TscSync *sync)
+{
+  size_t n;
+
+  sync->cpus = options.cpus.empty() ? online_cpus() : options.cpus;
+  n          = sync->cpus.size();
+  sync->offsets.assign(n, 0);
+  sync->uncertainties.assign(n, 0);
+  sync->maxSkew      = 0;
+  sync->maxWarp      = 0;
+  sync->violations   = 0;
+  sync->complete     = true;
+  sync->synchronized = true;
+
+  for (size_t i = 1; i < n; ++i)
+  {
+    uint64_t violations = 0, warp = 0;
+
+    if (!check_pair(sync->cpus[0], sync->cpus[i], options, &sync->offsets[i],
+                    &sync->uncertainties[i], &violations, &warp))
+      sync->complete = false;
+    sync->violations += violations;
+    sync->maxWarp     = max(sync->maxWarp, static_cast<int64_t>(warp));
+
+    if (((sync->offsets[i] < 0) ? -sync->offsets[i] : sync->offsets[i]) >
+        sync->uncertainties[i] + options.tolerance)
+      sync->synchronized = false;
+  }
+
+  if (n > 0)
+  {
+    auto range = minmax_element(sync->offsets.begin(), sync->offsets.end());
+    sync->maxSkew = *range.second - *range.first;
+  }
+  sync->synchronized = sync->synchronized && sync->complete &&
+                       (sync->violations == 0);
+
+  return sync->synchronized;
+}
+
+
+bool libcpu::tsc_reliable()
+{
+  static const bool reliable = []() {
+    TscSync sync;
+    return current().invariantTsc && check_tsc_sync(TscSyncOptions(), &sync);
+  }();
+
+  return reliable;
+}
@@ -0,0 +1,96 @@
+//
+// This file is subject to the terms and conditions defined in
+// file 'LICENSE', which is part of this source code package.
+//
+
+#ifndef LIB_CPU_TSCSYNC_H
+#define LIB_CPU_TSCSYNC_H
+
+#include <cstdint>
+#include <vector>
+
+namespace libcpu {
+
+//!
+//! @brief Parameters of the TSC synchronization check
+//!
+struct TscSyncOptions
+{
+  //! @brief OS logical processors to check (empty: every processor); the
+  //!        first one is the reference
+  std::vector<int> cpus;
+
+  //! @brief offset samples per processor; the one with the shortest round
+  //!        trip is kept
+  int samples = 1000;
+
+  //! @brief ordered TSC reads per processor pair in the monotonicity test
+  int iterations = 100000;
+
+  //! @brief skew beyond the measurement uncertainty that is still accepted
+  //!        (cycles)
+  int64_t tolerance = 100;
+};
+
+//!
+//! @brief Result of the TSC synchronization check
+//!
+struct TscSync
+{
+  //! @brief processors checked, the reference first
+  std::vector<int> cpus;
+
+  //! @brief TSC of each processor minus the TSC of the reference (cycles)
+  std::vector<int64_t> offsets;
+
+  //! @brief half the round trip of the kept sample: the offset is exact to
+  //!        within this many cycles
+  std::vector<int64_t> uncertainties;
+
+  //! @brief largest difference between two offsets (cycles)
+  int64_t maxSkew = 0;
+
+  //! @brief largest backward step seen by the monotonicity test (cycles)
+  int64_t maxWarp = 0;
+
+  //! @brief TSC reads that were lower than a read on another processor that
+  //!        happened before them
+  uint64_t violations = 0;
+
+  //! @brief every processor could be pinned
+  bool complete = false;
+
+  //! @brief no violation and every offset within its uncertainty plus the
+  //!        tolerance
+  bool synchronized = false;
+};
+
+
+//!
+//! @brief measure the TSC offsets and monotonicity across processors
+//!
+//! Every processor is paired with the reference. The offset is estimated
+//! from a timestamp exchange (the remote read must lie between the two
+//! reference reads), and both threads then take turns reading the TSC under
+//! a lock, so any read lower than its predecessor is a cross-processor
+//! warp.
+//!
+//! @param[in]    options   check parameters
+//! @param[out]   sync      offsets, worst skew and violations
+//!
+//! @return sync->synchronized
+//!
+bool check_tsc_sync(const TscSyncOptions &options, TscSync *sync);
+
+
+//!
+//! @brief whether RDTSC timestamps can be compared between threads
+//!
+//! True if current() reports an invariant TSC and check_tsc_sync() with the
+//! default options passes. The check runs once per process.
+//!
+bool tsc_reliable();
+
+} // namespace libcpu
+
+#endif // LIB_CPU_TSCSYNC_H